@@ -4,11 +4,177 @@
 #include <string>
 #include <sstream>
 #include <cstdlib>
+#include <cstdint>
 #include <limits>
 #include <filesystem>
+#include <unordered_set>
+#include <atomic>
+
+#include "ConfigFile.h"
+#include "IdCatalog.h"
+#include "Progress.h"
 
 namespace fs = std::filesystem;
 
+// 只在配置末尾追加数对，不改写已有内容。
+// 建立时用已有数对（及本次已加入的数对）建立哈希索引，重复的数对不会再写入。
+class PairAppender {
+public:
+    PairAppender(std::string path, std::string section) : path_(std::move(path)), section_(std::move(section)) {
+        ConfigFile config;
+        if (loadConfigFile(path_, config)) {
+            need_header_ = config.sectionId(section_) == UINT32_MAX;
+            for (const auto& pair : config.pairsIn(section_))
+                known_.insert(key(pair.first, pair.second));
+        }
+    }
+
+    // 已存在时返回 false
+    bool add(int original_code, int target_code) {
+        if (!known_.insert(key(original_code, target_code)).second) return false;
+        pending_ += "   - [" + std::to_string(original_code) + ", " + std::to_string(target_code) + "]\n";
+        added_++;
+        return true;
+    }
+
+    // 一次性追加到文件末尾；原文件最后一行没有换行时先补上换行
+    bool flush() {
+        if (pending_.empty()) return true;
+        std::string text;
+        {
+            std::ifstream in(path_, std::ios::binary | std::ios::ate);
+            if (in && in.tellg() > 0) {
+                in.seekg(-1, std::ios::end);
+                char last = 0;
+                if (in.get(last) && last != '\n') text += '\n';
+            }
+        }
+        if (need_header_) text += section_ + ":\n";
+        text += pending_;
+        std::ofstream out(path_, std::ios::binary | std::ios::app);
+        if (!out) return false;
+        out.write(text.data(), text.size());
+        if (!out) return false;
+        pending_.clear();
+        need_header_ = false;
+        return true;
+    }
+
+    const std::string& path() const { return path_; }
+    size_t added() const { return added_; }
+
+private:
+    static uint64_t key(int original_code, int target_code) {
+        return (uint64_t(uint32_t(original_code)) << 32) | uint32_t(target_code);
+    }
+
+    std::string path_;
+    std::string section_;
+    std::unordered_set<uint64_t> known_;
+    std::string pending_;
+    bool need_header_ = true;
+    size_t added_ = 0;
+};
+
+std::vector<unsigned char> hex_to_bytes(const std::string& hex) {
+    std::vector<unsigned char> bytes;
+    if (hex.size() % 2 != 0 || hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+        return {};
+    for (size_t i = 0; i < hex.size(); i += 2)
+        bytes.push_back(static_cast<unsigned char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    return bytes;
+}
+
+std::vector<unsigned char> config_marker(const std::string& path, const std::string& key, const std::string& fallback) {
+    ConfigFile config;
+    const std::string* value = nullptr;
+    if (loadConfigFile(path, config)) value = config.value("hex_markers", key);
+    return hex_to_bytes(value ? *value : fallback);
+}
+
+// 加入数对前用解包数据的代码目录检查两个代码是否都能被对应的工具找到。
+// 建立时增量更新一次目录（只扫描变化的文件），之后每次检查只是查表；没有解包数据或特征值时不检查
+class PairChecker {
+public:
+    PairChecker() {
+        if (!fs::is_directory(directory_)) {
+            std::cout << "未找到 '" << directory_ << "'，不检查代码是否存在。" << std::endl;
+            return;
+        }
+        markers_.block_start = config_marker("cloth.yaml", "start", "");
+        markers_.block_end = config_marker("cloth.yaml", "end", "");
+        markers_.icon_start = config_marker("伪实体配置.yaml", "start", "aa78");
+        markers_.icon_end = config_marker("伪实体配置.yaml", "end", "9e78");
+        if (markers_.block_start.empty() || markers_.block_end.empty()) {
+            std::cout << "cloth.yaml 中没有特征值，不检查代码是否存在。" << std::endl;
+            return;
+        }
+        std::vector<std::string> files;
+        uint64_t total_bytes = 0;
+        for (auto& entry : fs::recursive_directory_iterator(directory_)) {
+            if (fs::is_regular_file(entry.path())) {
+                files.push_back(entry.path().string());
+                total_bytes += entry.file_size();
+            }
+        }
+
+        // 有进度通道（从 Menu 运行）时由 Menu 显示进度，否则在终端显示
+        std::string path = catalogPathFor(directory_);
+        WorkStealingPool pool;
+        ProgressReporter reporter;
+        std::atomic<size_t> progress(0);
+        std::atomic<uint64_t> progress_bytes(0);
+        auto show_progress = [&]() {
+            reporter.update(progress.load(), progress_bytes.load());
+            if (!reporter.enabled())
+                std::cout << "\r代码目录: " << progress.load() << "/" << files.size() << " 个文件" << std::flush;
+        };
+        reporter.begin("更新代码目录", files.size(), total_bytes);
+        CatalogUpdateStats stats =
+            updateIdCatalog(path, files, markers_, pool, &progress, &progress_bytes, show_progress);
+        reporter.update(progress.load(), progress_bytes.load());
+        reporter.end();
+        if (stats.scanned > 0 && !reporter.enabled())
+            std::cout << "\r代码目录: " << files.size() << "/" << files.size() << " 个文件" << std::endl;
+        if (stats.written) {
+            std::cout << "代码目录已更新：扫描 " << stats.scanned << " 个文件，沿用 " << stats.reused
+                      << " 个文件。" << std::endl;
+        }
+        enabled_ = catalog_.open(path);
+    }
+
+    // 目录中找不到的代码（没有目录时不检查，返回空）
+    std::vector<int> missing(int original_code, int target_code, CatalogKind kind) const {
+        std::vector<int> result;
+        if (!enabled_) return result;
+        for (int code : {original_code, target_code}) {
+            if (!catalog_.has(static_cast<uint32_t>(code), kind)) result.push_back(code);
+        }
+        return result;
+    }
+
+private:
+    const std::string directory_ = "解包数据/uexp";
+    CatalogMarkers markers_;
+    IdCatalog catalog_;
+    bool enabled_ = false;
+};
+
+// 目录中找不到的代码只作提醒：目录可能落后于解包数据，由用户确认（或 --force）后照常加入
+bool confirm_missing(const std::vector<int>& codes, const std::string& kind_name, const std::string& path,
+                     bool force) {
+    if (codes.empty()) return true;
+    std::cout << "警告: 代码 ";
+    for (size_t i = 0; i < codes.size(); i++)
+        std::cout << (i ? ", " : "") << codes[i];
+    std::cout << " 不在解包数据的" << kind_name << "中，工具可能找不到它。" << std::endl;
+    if (force) return true;
+    std::cout << "仍然加入 '" << path << "'？（1/0）：";
+    std::string answer;
+    std::cin >> answer;
+    return answer == "1";
+}
+
 std::pair<std::vector<int>, bool> get_swap_pair() {
     int original_code, target_code;
     bool skip = false;
@@ -37,54 +203,35 @@ std::pair<std::vector<int>, bool> get_swap_pair() {
     }
 }
 
-void main_process() {
-    std::string file_path = "cloth.yaml";
-    std::string file_path2 = "伪实体配置.yaml";
-
-    std::vector<std::string> content;
-    if (fs::exists(file_path)) {
-        std::ifstream file(file_path);
-        if (file.is_open()) {
-            std::string line;
-            while (std::getline(file, line)) {
-                if (!line.empty() && line.back() == '\n') {
-                    line.pop_back();
-                }
-                content.push_back(line);
-            }
-            file.close();
+bool flush_all(PairAppender& cloth, PairAppender& icon) {
+    bool ok = true;
+    for (PairAppender* appender : {&cloth, &icon}) {
+        if (!appender->flush()) {
+            std::cerr << "错误: 无法写入文件 '" << appender->path() << "'" << std::endl;
+            ok = false;
         }
     }
+    return ok;
+}
 
-    std::vector<std::string> content2;
-    if (fs::exists(file_path2)) {
-        std::ifstream file(file_path2);
-        if (file.is_open()) {
-            std::string line;
-            while (std::getline(file, line)) {
-                if (!line.empty() && line.back() == '\n') {
-                    line.pop_back();
-                }
-                content2.push_back(line);
-            }
-            file.close();
-        }
-    } else {
-        content2.push_back("search_targets:");
-    }
+void main_process(bool force) {
+    PairChecker checker;
+    PairAppender cloth("cloth.yaml", "swap_pairs");
+    PairAppender icon("伪实体配置.yaml", "search_targets");
 
-    std::cout << "当前文件路径: " << file_path << std::endl;
+    std::cout << "当前文件路径: " << cloth.path() << std::endl;
     std::cout << "请输入 swap pairs，按要求格式输入：" << std::endl;
 
     while (true) {
         auto [swap_pair, skip] = get_swap_pair();
         if (!swap_pair.empty()) {
-            std::ostringstream ss;
-            ss << "   - [" << swap_pair[0] << ", " << swap_pair[1] << "]";
-            content.push_back(ss.str());
-
+            auto missing = checker.missing(swap_pair[0], swap_pair[1], kCatalogCloth);
+            if (confirm_missing(missing, "衣服块", cloth.path(), force) && !cloth.add(swap_pair[0], swap_pair[1]))
+                std::cout << "该数对已在 '" << cloth.path() << "' 中，跳过。" << std::endl;
             if (!skip) {
-                content2.push_back(ss.str());
+                missing = checker.missing(swap_pair[0], swap_pair[1], kCatalogIcon);
+                if (confirm_missing(missing, "图标映射", icon.path(), force) && !icon.add(swap_pair[0], swap_pair[1]))
+                    std::cout << "该数对已在 '" << icon.path() << "' 中，跳过。" << std::endl;
             }
         }
 
@@ -96,29 +243,106 @@ void main_process() {
         }
     }
 
-    std::ofstream file1(file_path);
-    if (file1.is_open()) {
-        for (size_t i = 0; i < content.size(); ++i) {
-            file1 << content[i];
-            if (i != content.size() - 1) file1 << '\n';
+    flush_all(cloth, icon);
+    std::cout << "输入完成，数对已添加到 '" << cloth.path() << "' 和 '" << icon.path() << "'。" << std::endl;
+}
+
+// 批量导入：每行 "原代码,目标代码[,s]"，分隔符可以是逗号、分号、空白；带 s 的数对不写入伪实体配置。
+// 空行和 # 开头的行忽略，其他无法解析的行（如表头）计为无效。
+// 含有目录中找不到的代码的数对默认不加入，force 时照常加入，两种情况都会列出这些代码。
+int bulk_import(const std::string& source, bool force) {
+    std::ifstream file;
+    if (source != "-") {
+        file.open(source);
+        if (!file) {
+            std::cerr << "错误: 无法打开文件 '" << source << "'" << std::endl;
+            return 1;
         }
-        file1.close();
     }
+    std::istream& in = source == "-" ? std::cin : file;
 
-    std::ofstream file2(file_path2);
-    if (file2.is_open()) {
-        for (size_t i = 0; i < content2.size(); ++i) {
-            file2 << content2[i];
-            if (i != content2.size() - 1) file2 << '\n';
+    PairChecker checker;
+    PairAppender cloth("cloth.yaml", "swap_pairs");
+    PairAppender icon("伪实体配置.yaml", "search_targets");
+    size_t total = 0, duplicates = 0;
+    std::vector<size_t> invalid_lines;
+    std::vector<int> missing_codes;  // 目录中找不到的代码（去重，按出现顺序）
+    std::unordered_set<int> missing_seen;
+    size_t unknown = 0;
+    struct Row {
+        int32_t original_code;
+        int32_t target_code;
+        bool icon;
+    };
+    std::vector<Row> rows;
+    std::string line;
+    for (size_t line_number = 1; std::getline(in, line); line_number++) {
+        for (char& c : line)
+            if (c == ',' || c == ';') c = ' ';
+        std::istringstream fields(line);
+        std::string first, second, flag;
+        if (!(fields >> first) || first[0] == '#') continue;
+        fields >> second >> flag;
+        int32_t original_code, target_code;
+        size_t i = 0, j = 0;
+        if (!config_detail::parseNumber(first, i, original_code) || i != first.size() ||
+            !config_detail::parseNumber(second, j, target_code) || j != second.size() ||
+            !(flag.empty() || flag == "s")) {
+            invalid_lines.push_back(line_number);
+            continue;
         }
-        file2.close();
+        rows.push_back({original_code, target_code, flag.empty()});
     }
 
-    std::cout << "输入完成，数对已添加到 '" << file_path << "' 和 '" << file_path2 << "'。" << std::endl;
-}
+    for (const Row& row : rows) {
+        total++;
+        bool added = false, known = true;
+        auto check = [&](CatalogKind kind) {
+            auto missing = checker.missing(row.original_code, row.target_code, kind);
+            for (int code : missing)
+                if (missing_seen.insert(code).second) missing_codes.push_back(code);
+            if (!missing.empty()) known = false;
+            return missing.empty() || force;
+        };
+        if (check(kCatalogCloth)) added = cloth.add(row.original_code, row.target_code);
+        if (row.icon && check(kCatalogIcon)) added = icon.add(row.original_code, row.target_code) || added;
+        if (!known) unknown++;
+        if (!added && (known || force)) duplicates++;
+    }
 
+    if (!flush_all(cloth, icon)) return 1;
+    std::cout << "共读取 " << total << " 对：'" << cloth.path() << "' 新增 " << cloth.added() << " 对，'"
+              << icon.path() << "' 新增 " << icon.added() << " 对，" << duplicates << " 对已存在。" << std::endl;
+    if (unknown > 0) {
+        std::cout << "警告: " << unknown << " 对含有解包数据中找不到的代码，"
+                  << (force ? "已按 --force 加入" : "未加入对应文件") << "（代码：";
+        for (size_t k = 0; k < missing_codes.size() && k < 10; k++)
+            std::cout << (k ? ", " : "") << missing_codes[k];
+        std::cout << (missing_codes.size() > 10 ? " ..." : "") << "）" << std::endl;
+        if (!force) std::cout << "确认这些代码无误时，加上 --force 重新导入即可加入。" << std::endl;
+    }
+    if (!invalid_lines.empty()) {
+        std::cout << invalid_lines.size() << " 行无法解析，已跳过（行号：";
+        for (size_t k = 0; k < invalid_lines.size() && k < 10; k++)
+            std::cout << (k ? ", " : "") << invalid_lines[k];
+        std::cout << (invalid_lines.size() > 10 ? " ..." : "") << "）" << std::endl;
+    }
+    return 0;
+}
 
-int main() {
-    main_process();
+// 不带参数时逐个输入；./AutoAdd pairs.csv 或 ./AutoAdd - （从标准输入读取）批量导入。
+// --force：目录中找不到的代码也直接加入，不再询问
+int main(int argc, char* argv[]) {
+    bool force = false;
+    std::string source;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--force")
+            force = true;
+        else
+            source = arg;
+    }
+    if (!source.empty()) return bulk_import(source, force);
+    main_process(force);
     return 0;
 }
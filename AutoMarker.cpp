@@ -6,11 +6,22 @@
 #include <cstdint>
 #include <iomanip>
 #include <filesystem>
-#include <future>
-#include <mutex>
 #include <map>
 #include <set>
 #include <algorithm>
+#include <unordered_map>
+#include <tuple>
+#include <iterator>
+#include <cctype>
+
+#include "ByteSearch.h"
+#include "SkinLayout.h"
+#include "HitHistory.h"
+#include "MappedFile.h"
+#include "WorkStealing.h"
+#include "IdMatcher.h"
+#include "FileStamp.h"
+#include "ToolServer.h"
 
 namespace fs = std::filesystem;
 
@@ -38,70 +49,156 @@ std::vector<uint8_t> hex_string_to_bytes(const std::string& hex) {
     return bytes;
 }
 
-bool search_bytes_in_file(const std::string& file_path, const std::vector<uint8_t>& pattern) {
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file) return false;
-
-    file.seekg(0, std::ios::end);
-    size_t size = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    std::vector<uint8_t> content(size);
-    if (!file.read(reinterpret_cast<char*>(content.data()), size)) return false;
+// 一个命中锚点代码的 dat：加载一次就同时得到分类和提取特征值需要的全部信息
+struct DatFile {
+    std::string path;
+    std::string category;
+    bool has_category_pattern = false;   // 是否包含分类特征（WeaponPublic）
+    bool has_target = false;
+    size_t target_position = 0;
+    std::vector<uint8_t> before_target;  // 目标值之前最多 kMarkerLookBehind 字节
+};
+
+constexpr size_t kMarkerLookBehind = 41;
+
+// 加载（优先 mmap）文件一次：先找锚点，命中后在同一份数据上查找分类特征和目标值。
+// 文件无法读取时返回 false；没有锚点时 hit 为 false。
+bool scan_dat_file(const std::string& file_path,
+                   const std::vector<uint8_t>& anchor,
+                   const std::vector<uint8_t>& category_pattern,
+                   const std::vector<uint8_t>& target,
+                   bool& hit, DatFile& out) {
+    hit = false;
+    MappedFile mapped(file_path);
+    std::vector<uint8_t> buffer;
+    const uint8_t* data = mapped.data();
+    size_t size = mapped.size();
+    if (!mapped.mapped()) {
+        std::ifstream file(file_path, std::ios::binary);
+        if (!file) return false;
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+    }
 
-    return std::search(content.begin(), content.end(), pattern.begin(), pattern.end()) != content.end();
+    if (bytesearch::findBytes(data, size, anchor.data(), anchor.size()) == bytesearch::npos) return true;
+    hit = true;
+    out.path = file_path;
+    out.has_category_pattern =
+        bytesearch::findBytes(data, size, category_pattern.data(), category_pattern.size()) != bytesearch::npos;
+    size_t pos = bytesearch::findBytes(data, size, target.data(), target.size());
+    out.has_target = pos != bytesearch::npos;
+    if (out.has_target) {
+        out.target_position = pos;
+        size_t from = pos - std::min(pos, kMarkerLookBehind);
+        out.before_target.assign(data + from, data + pos);
+    }
+    return true;
 }
 
-std::vector<std::string> search_dat_files(const std::string& directory, const std::string& hex_str) {
-    std::vector<std::string> matches;
-    std::mutex mutex;
-    std::vector<std::future<void>> futures;
+// 每个 dat 的查找结果按文件的大小和修改时间缓存在进程内。单次运行时缓存为空；
+// 作为常驻服务（--serve）运行时，之后的每次运行只重新加载发生变化的文件。
+struct DatScan {
+    FileStamp stamp;
+    bool hit = false;
+    DatFile dat;
+};
+
+struct DatScanCache {
+    std::string key;  // 锚点、分类特征和目标值
+    std::unordered_map<std::string, DatScan> files;
+};
+
+DatScanCache g_dat_scan_cache;
+
+// 查找包含 hex_str 的 dat，并在同一次加载中完成分类特征和目标值的查找
+std::vector<DatFile> search_dat_files(const std::string& directory, const std::string& hex_str,
+                                      const std::vector<uint8_t>& category_pattern,
+                                      const std::vector<uint8_t>& target) {
+    std::vector<DatFile> matches;
     auto pattern = hex_string_to_bytes(hex_str);
+    std::string key = hex_str + ":" + std::string(category_pattern.begin(), category_pattern.end()) + ":" +
+                      std::string(target.begin(), target.end());
+    if (g_dat_scan_cache.key != key) {
+        g_dat_scan_cache.files.clear();
+        g_dat_scan_cache.key = key;
+    }
 
+    std::vector<std::string> paths;
+    std::vector<FileStamp> stamps;
     for (const auto& entry : fs::recursive_directory_iterator(directory)) {
         if (entry.is_regular_file() && entry.path().extension() == ".dat") {
-            std::string path = entry.path().string();
-            futures.emplace_back(std::async(std::launch::async, 
-                [path, &pattern, &matches, &mutex]() {
-                    if (search_bytes_in_file(path, pattern)) {
-                        std::lock_guard<std::mutex> lock(mutex);
-                        matches.push_back(path);
-                    }
-                }));
+            FileStamp stamp;
+            stamp.mtime = -1;
+            paths.push_back(entry.path().string());
+            statFile(paths.back(), stamp);
+            stamps.push_back(stamp);
         }
     }
 
-    for (auto& future : futures) {
-        future.wait();
+    // 沿用缓存中没有变化的文件。扫描成功后才记下修改时间，读取失败或运行被取消（见 Cancel.h）
+    // 而没有扫描的文件修改时间保持 -1，下次重新扫描
+    std::vector<DatScan*> entries(paths.size());
+    std::vector<char> done(paths.size());
+    std::unordered_map<std::string, DatScan> kept;
+    for (size_t i = 0; i < paths.size(); i++) {
+        auto it = g_dat_scan_cache.files.find(paths[i]);
+        DatScan& cached = kept[paths[i]];
+        if (it != g_dat_scan_cache.files.end() && it->second.stamp.mtime >= 0 &&
+            it->second.stamp.size == stamps[i].size && it->second.stamp.mtime == stamps[i].mtime) {
+            cached = std::move(it->second);
+            done[i] = 1;
+        } else {
+            cached.stamp = stamps[i];
+            cached.stamp.mtime = -1;
+        }
+        entries[i] = &cached;
+    }
+    g_dat_scan_cache.files = std::move(kept);
+
+    // 上次没有命中且之后没有变化的文件直接跳过
+    std::string history_path = hitHistoryPathFor(directory);
+    HitHistory history;
+    history.load(history_path, hex_str);
+    // 跳过哪些文件在启动线程前确定，工作线程只读 skip，不再查询正在被 record 修改的记录
+    std::vector<char> skip(paths.size());
+    std::vector<uint64_t> weights(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        skip[i] = !done[i] && history.knownMiss(paths[i]);
+        weights[i] = skip[i] || done[i] ? 0 : stamps[i].size;
     }
+    WorkStealingPool pool;
+    pool.run(weights, [&](size_t, size_t task) {
+        if (skip[task] || done[task]) return;
+        DatScan& entry = *entries[task];
+        done[task] = scan_dat_file(paths[task], pattern, category_pattern, target, entry.hit, entry.dat);
+        if (done[task]) entry.stamp.mtime = stamps[task].mtime;
+    });
+    for (size_t i = 0; i < paths.size(); i++) {
+        DatScan& entry = *entries[i];
+        if (!done[i]) continue;
+        history.record(paths[i], entry.hit);
+        if (entry.hit) matches.push_back(entry.dat);
+    }
+    history.save(history_path, hex_str, paths);
 
     return matches;
 }
 
-std::map<std::string, std::string> classify_files(const std::vector<std::string>& matches, const std::string& target_hex) {
-    std::map<std::string, std::string> result;
-    if (matches.size() != 2) {
-        for (const auto& file : matches) {
-            result[file] = "未分类";
-        }
-        return result;
-    }
-
-    auto target_pattern = hex_string_to_bytes(target_hex);
-    bool file1_has = search_bytes_in_file(matches[0], target_pattern);
-    bool file2_has = search_bytes_in_file(matches[1], target_pattern);
-
+// 恰好两个 dat 命中时，包含分类特征的是皮肤，另一个是伪实体；否则都不分类
+void classify_files(std::vector<DatFile>& matches) {
+    for (auto& dat : matches)
+        dat.category = "未分类";
+    if (matches.size() != 2) return;
+    bool file1_has = matches[0].has_category_pattern;
+    bool file2_has = matches[1].has_category_pattern;
     if (file1_has && !file2_has) {
-        result[matches[0]] = "皮肤";
-        result[matches[1]] = "伪实体";
+        matches[0].category = "皮肤";
+        matches[1].category = "伪实体";
     } else if (file2_has && !file1_has) {
-        result[matches[1]] = "皮肤";
-        result[matches[0]] = "伪实体";
-    } else {
-        result[matches[0]] = "未分类";
-        result[matches[1]] = "未分类";
+        matches[1].category = "皮肤";
+        matches[0].category = "伪实体";
     }
-    return result;
 }
 
 std::string bytes_to_hex_string(const uint8_t* data, size_t length) {
@@ -112,45 +209,266 @@ std::string bytes_to_hex_string(const uint8_t* data, size_t length) {
     return ss.str();
 }
 
-std::pair<std::string, std::string> extract_markers(const std::string& file_path, 
-                                                   const std::string& hex_pattern,
-                                                   const std::string& category) {
-    auto pattern = hex_string_to_bytes(hex_pattern);
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file) return {"", ""};
+std::pair<std::string, std::string> extract_markers(const DatFile& dat) {
+    if (!dat.has_target) return {"", ""};
 
-    file.seekg(0, std::ios::end);
-    size_t size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    int position = static_cast<int>(dat.target_position);
+    // before_target 从 position - base_offset 开始
+    int base_offset = static_cast<int>(dat.before_target.size());
+    const uint8_t* base = dat.before_target.data();
+    auto marker_at = [&](int back_start, int back_end) {
+        int start = std::max(0, position - back_start);
+        int end = std::max(0, position - back_end);
+        return bytes_to_hex_string(base + (start - (position - base_offset)), end - start);
+    };
 
-    std::vector<uint8_t> content(size);
-    if (!file.read(reinterpret_cast<char*>(content.data()), size)) return {"", ""};
+    std::string marker1, marker2;
+    if (dat.category == "皮肤") {
+        marker1 = marker_at(33, 31);
+        marker2 = marker_at(17, 15);
+    } else if (dat.category == "伪实体") {
+        marker1 = marker_at(41, 39);
+        marker2 = marker_at(25, 23);
+    }
 
-    auto pos = std::search(content.begin(), content.end(), pattern.begin(), pattern.end());
-    if (pos == content.end()) return {"", ""};
+    return {marker1, marker2};
+}
 
-    int position = std::distance(content.begin(), pos);
-    std::string marker1, marker2;
+// ========== 多锚点特征值排名 ==========
+//
+// 特征值布局与 fast.cpp 相同：起始特征值（2 字节）+ 14 字节 + 结束特征值（2 字节），
+// 皮肤代码在结束特征值之后 15 字节；伪实体代码再往后 8 字节。
+// 对语料中每个锚点代码的每次出现，按两种布局各取一对候选特征值并计数，
+// 被越多不同代码支持的候选越可信。固定偏移的计数不保证 fast 真能用这对特征值找到块（中间可能先出现结束特征值），
+// 所以排名靠前的候选再用 fast 的块查找（forEachMarkedValue）扫描一遍，按实际找回的锚点代码数排序，
+// 一个锚点都找不回的候选去掉。
+// 因此这里读取两遍 dat，不是单次扫描：块查找是否找到某对特征值取决于之前在哪里找到结束特征值，
+// 要先知道候选才能模拟，无法在统计时顺便完成。第二遍只读取第一遍中出现过锚点代码的 dat
+// （其他文件不可能找回锚点），每个文件对每个候选各做一次块查找，最多 2 × kValidatedCandidates 次。
+
+constexpr size_t kMarkerLength = 2;
+constexpr size_t kMarkerGap = 14;
+
+struct MarkerLayout {
+    const char* name;
+    size_t start_back;  // 起始特征值在代码之前多少字节
+    size_t end_back;    // 结束特征值在代码之前多少字节
+};
+
+constexpr MarkerLayout kMarkerLayouts[] = {{"皮肤", 33, 17}, {"伪实体", 41, 25}};
+
+static_assert(33 - 17 == kMarkerLength + kMarkerGap && 41 - 25 == kMarkerLength + kMarkerGap,
+              "起止特征值之间必须相隔 14 字节");
+// 代码搜索的索引（IdIndex.h）按同样的布局收录代码位置
+static_assert(17 == kMarkerLength + kBlockTargetSkip && 25 == kMarkerLength + kEntityTargetSkip &&
+                  kMarkerGap == kBlockMarkerGap,
+              "布局必须与 SkinLayout.h 一致");
+
+// 皮肤等代码都不小于这个值，更小的数字不作为锚点
+constexpr uint32_t kMinAnchorCode = 100000;
+// 每种布局用块查找验证的候选数
+constexpr size_t kValidatedCandidates = 16;
+
+struct RankedMarker {
+    size_t layout;
+    std::string start;
+    std::string end;
+    uint64_t hits;     // 支持这对特征值的出现次数
+    size_t anchors;    // 支持这对特征值的不同代码数
+    uint64_t recovered_hits = 0;  // 块查找找回锚点代码的次数
+    size_t recovered = 0;         // 块查找找回的不同锚点代码数
+};
+
+// 扫描 directory 下的 dat，同时统计所有锚点代码的候选特征值，再用块查找验证排名靠前的候选，
+// 按找回的代码数和次数排序
+std::vector<RankedMarker> rank_markers(const std::string& directory, const std::vector<int32_t>& anchors) {
+    const IdMatcher matcher(anchors);
+    std::vector<std::string> paths;
+    std::vector<uint64_t> sizes;
+    for (const auto& entry : fs::recursive_directory_iterator(directory)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".dat") {
+            paths.push_back(entry.path().string());
+            std::error_code ec;
+            uint64_t size = entry.file_size(ec);
+            sizes.push_back(ec ? 0 : size);
+        }
+    }
 
-    if (category == "皮肤") {
-        int start1 = std::max(0, position - 33);
-        int end1 = std::max(0, position - 31);
-        int start2 = std::max(0, position - 17);
-        int end2 = std::max(0, position - 15);
-
-        marker1 = bytes_to_hex_string(content.data() + start1, end1 - start1);
-        marker2 = bytes_to_hex_string(content.data() + start2, end2 - start2);
-    } else if (category == "伪实体") {
-        int start1 = std::max(0, position - 41);
-        int end1 = std::max(0, position - 39);
-        int start2 = std::max(0, position - 25);
-        int end2 = std::max(0, position - 23);
-
-        marker1 = bytes_to_hex_string(content.data() + start1, end1 - start1);
-        marker2 = bytes_to_hex_string(content.data() + start2, end2 - start2);
+    struct Tally {
+        uint64_t hits = 0;
+        std::set<size_t> anchors;
+    };
+    // 键：布局 << 32 | 起始特征值 << 16 | 结束特征值
+    using TallyMap = std::unordered_map<uint64_t, Tally>;
+    WorkStealingPool pool;
+    std::vector<TallyMap> tallies(pool.size());
+    std::vector<char> has_anchor(paths.size());  // 出现过锚点代码的 dat，第二遍只读取这些文件
+    pool.run(sizes, [&](size_t worker, size_t task) {
+        MappedFile mapped(paths[task]);
+        std::vector<uint8_t> buffer;
+        const uint8_t* data = mapped.data();
+        size_t size = mapped.size();
+        if (!mapped.mapped()) {
+            std::ifstream file(paths[task], std::ios::binary);
+            if (!file) return;
+            buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            data = buffer.data();
+            size = buffer.size();
+        }
+        TallyMap& tally = tallies[worker];
+        matcher.scan(data, size, [&](size_t index, size_t pos) {
+            for (size_t layout = 0; layout < std::size(kMarkerLayouts); layout++) {
+                const MarkerLayout& l = kMarkerLayouts[layout];
+                if (pos < l.start_back) continue;
+                const uint8_t* start = data + pos - l.start_back;
+                const uint8_t* end = data + pos - l.end_back;
+                uint64_t key = (uint64_t(layout) << 32) | (uint32_t(start[0]) << 24) | (uint32_t(start[1]) << 16) |
+                               (uint32_t(end[0]) << 8) | end[1];
+                Tally& t = tally[key];
+                t.hits++;
+                t.anchors.insert(index);
+            }
+            has_anchor[task] = 1;
+            return true;
+        });
+    });
+
+    TallyMap merged;
+    for (auto& tally : tallies) {
+        for (auto& [key, t] : tally) {
+            Tally& m = merged[key];
+            m.hits += t.hits;
+            m.anchors.insert(t.anchors.begin(), t.anchors.end());
+        }
+    }
+    std::vector<RankedMarker> ranked;
+    for (const auto& [key, t] : merged) {
+        uint8_t start[2] = {uint8_t(key >> 24), uint8_t(key >> 16)};
+        uint8_t end[2] = {uint8_t(key >> 8), uint8_t(key)};
+        ranked.push_back({static_cast<size_t>(key >> 32), bytes_to_hex_string(start, 2),
+                          bytes_to_hex_string(end, 2), t.hits, t.anchors.size()});
     }
+    std::sort(ranked.begin(), ranked.end(), [](const RankedMarker& a, const RankedMarker& b) {
+        if (a.layout != b.layout) return a.layout < b.layout;
+        if (a.anchors != b.anchors) return a.anchors > b.anchors;
+        if (a.hits != b.hits) return a.hits > b.hits;
+        return std::tie(a.start, a.end) < std::tie(b.start, b.end);
+    });
+
+    // 验证：每种布局取前 kValidatedCandidates 个候选，用块查找扫描全部 dat，统计找回的锚点代码
+    std::vector<RankedMarker> candidates;
+    std::vector<size_t> taken(std::size(kMarkerLayouts));
+    for (const auto& r : ranked)
+        if (taken[r.layout]++ < kValidatedCandidates) candidates.push_back(r);
+    std::vector<std::vector<unsigned char>> starts, ends;
+    for (const auto& c : candidates) {
+        starts.push_back(hex_string_to_bytes(c.start));
+        ends.push_back(hex_string_to_bytes(c.end));
+    }
+    struct Recovery {
+        uint64_t hits = 0;
+        std::set<size_t> anchors;
+    };
+    std::vector<std::vector<Recovery>> recoveries(pool.size(), std::vector<Recovery>(candidates.size()));
+    std::vector<size_t> anchor_files;
+    std::vector<uint64_t> anchor_sizes;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!has_anchor[i]) continue;
+        anchor_files.push_back(i);
+        anchor_sizes.push_back(sizes[i]);
+    }
+    pool.run(anchor_sizes, [&](size_t worker, size_t task) {
+        withFileData(paths[anchor_files[task]], [&](const unsigned char* data, size_t size) {
+            for (size_t c = 0; c < candidates.size(); c++) {
+                size_t skip = kMarkerLayouts[candidates[c].layout].end_back - kMarkerLength;
+                Recovery& recovery = recoveries[worker][c];
+                forEachMarkedValue(data, size, starts[c], ends[c], skip, [&](uint32_t value, size_t) {
+                    int index = matcher.find(value);
+                    if (index < 0) return;
+                    recovery.hits++;
+                    recovery.anchors.insert(static_cast<size_t>(index));
+                });
+            }
+        });
+    });
+    std::vector<RankedMarker> validated;
+    for (size_t c = 0; c < candidates.size(); c++) {
+        Recovery merged_recovery;
+        for (auto& worker : recoveries) {
+            merged_recovery.hits += worker[c].hits;
+            merged_recovery.anchors.insert(worker[c].anchors.begin(), worker[c].anchors.end());
+        }
+        if (merged_recovery.anchors.empty()) continue;
+        candidates[c].recovered_hits = merged_recovery.hits;
+        candidates[c].recovered = merged_recovery.anchors.size();
+        validated.push_back(candidates[c]);
+    }
+    std::sort(validated.begin(), validated.end(), [](const RankedMarker& a, const RankedMarker& b) {
+        if (a.layout != b.layout) return a.layout < b.layout;
+        if (a.recovered != b.recovered) return a.recovered > b.recovered;
+        if (a.recovered_hits != b.recovered_hits) return a.recovered_hits > b.recovered_hits;
+        if (a.anchors != b.anchors) return a.anchors > b.anchors;
+        return std::tie(a.start, a.end) < std::tie(b.start, b.end);
+    });
+    return validated;
+}
 
-    return {marker1, marker2};
+// 参数可以是代码，也可以是包含代码的文件（如 cloth.yaml），文件中取所有可能是代码的数字
+std::vector<int32_t> parse_anchor_args(int argc, char* argv[]) {
+    std::vector<int32_t> anchors;
+    auto add = [&](const std::string& token) {
+        try {
+            long long value = std::stoll(token);
+            if (value >= kMinAnchorCode && value <= INT32_MAX)
+                anchors.push_back(static_cast<int32_t>(value));
+        } catch (const std::exception&) {
+        }
+    };
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.find_first_not_of("0123456789") == std::string::npos) {
+            add(arg);
+            continue;
+        }
+        std::ifstream in(arg);
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::string token;
+        for (char c : text + " ") {
+            if (std::isdigit(static_cast<unsigned char>(c))) {
+                token += c;
+            } else {
+                // 只取独立的数字，跳过 "9e78" 这类十六进制特征值中的数字
+                if (!token.empty() && !std::isalpha(static_cast<unsigned char>(c))) add(token);
+                token.clear();
+            }
+        }
+    }
+    return anchors;
+}
+
+int rank_markers_main(const std::string& directory, const std::vector<int32_t>& anchors) {
+    if (anchors.empty()) {
+        std::cerr << "错误: 未输入有效的代码。\n";
+        return 1;
+    }
+    std::cout << "读取两遍 dat：先统计候选特征值，再用块查找验证每种布局前 " << kValidatedCandidates
+              << " 个候选（只重新读取含有这些代码的 dat）。\n";
+    auto ranked = rank_markers(directory, anchors);
+    constexpr size_t kTopN = 10;
+    for (size_t layout = 0; layout < std::size(kMarkerLayouts); layout++) {
+        std::cout << kMarkerLayouts[layout].name << "特征值候选（共 " << anchors.size()
+                  << " 个代码，按块查找找回的代码数排序）：\n";
+        size_t shown = 0;
+        for (const auto& r : ranked) {
+            if (r.layout != layout) continue;
+            if (shown++ == kTopN) break;
+            std::cout << "  " << r.start << ", " << r.end << "    找回 " << r.recovered << " 个代码，"
+                      << r.recovered_hits << " 次（按偏移统计 " << r.anchors << " 个代码，" << r.hits << " 次）\n";
+        }
+        if (shown == 0) std::cout << "  未找到\n";
+        std::cout << "\n";
+    }
+    return 0;
 }
 
 void update_yaml(const std::string& file_path, const std::string& marker1, const std::string& marker2) {
@@ -195,7 +513,7 @@ void update_beautification_yaml(const std::string& file_path, const std::string&
     }
 }
 
-int main() {
+int run_auto_marker(int argc, char* argv[]) {
     std::vector<int32_t> decimal_numbers = {333600100};
     std::vector<std::string> hex_list;
     for (auto num : decimal_numbers) {
@@ -207,16 +525,27 @@ int main() {
         return 1;
     }
 
+    // 带参数运行时只统计并列出候选特征值，不修改配置
+    if (argc > 1) {
+        return rank_markers_main(directory_to_search, parse_anchor_args(argc, argv));
+    }
+
     std::string skin_file, entity_file;
     std::pair<std::string, std::string> skin_markers, entity_markers;
 
+    auto category_pattern = hex_string_to_bytes("576561706F6E5075626C6963");
+    auto target_pattern = hex_string_to_bytes(decimal_to_little_endian_hex(413753));
     for (const auto& hex_str : hex_list) {
-        auto matches = search_dat_files(directory_to_search, hex_str);
-        auto classified = classify_files(matches, "576561706F6E5075626C6963");
-
-        std::string target_hex = decimal_to_little_endian_hex(413753);
-        for (const auto& [file, category] : classified) {
-            auto [marker1, marker2] = extract_markers(file, target_hex, category);
+        // 每个 dat 只加载一次：查找锚点、分类特征和目标值一起完成
+        auto matches = search_dat_files(directory_to_search, hex_str, category_pattern, target_pattern);
+        classify_files(matches);
+        std::sort(matches.begin(), matches.end(),
+                  [](const DatFile& a, const DatFile& b) { return a.path < b.path; });
+
+        for (const auto& dat : matches) {
+            const std::string& file = dat.path;
+            const std::string& category = dat.category;
+            auto [marker1, marker2] = extract_markers(dat);
             if (!marker1.empty() && !marker2.empty()) {
                 if (category == "皮肤") {
                     skin_file = file;
@@ -254,3 +583,8 @@ int main() {
 
     return 0;
 }
+
+// 有常驻服务（./AutoMarker --serve）时交给服务运行，沿用服务中缓存的查找结果
+int main(int argc, char* argv[]) {
+    return toolserver::runOrForward(argc, argv, "AutoMarker", run_auto_marker);
+}
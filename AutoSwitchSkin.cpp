@@ -5,18 +5,33 @@
 #include <string>
 #include <filesystem>
 #include <algorithm>
-#include <regex>
 #include <cstdlib>
 #include <cstdint>
 #include <utility>
+#include <set>
+#include <iterator>
+#include <cstring>
+#include <unordered_map>
+#include <cstdio>
+
+#include "IdMatcher.h"
+#include "SwapPlan.h"
+#include "WorkStealing.h"
+#include "ConfigFile.h"
+#include "Progress.h"
 
 namespace fs = std::filesystem;
 
-struct Config {
+// 一个美化目标：dat 文件名及其交换对
+struct Target {
     std::string file_path;
     std::vector<std::pair<int, int>> swap_pairs;
 };
 
+struct Config {
+    std::vector<Target> targets;
+};
+
 std::string trim(const std::string& s) {
     auto start = s.find_first_not_of(" \t\r\n");
     if (start == std::string::npos) return "";
@@ -24,168 +39,382 @@ std::string trim(const std::string& s) {
     return s.substr(start, end - start + 1);
 }
 
+// 每个 file_path 开始一个新目标，其后的 swap_pairs 属于该目标；
+// 第一个 file_path 之前的交换对属于第一个目标，因此只有一个目标的旧配置写法不变。
 Config load_config(const std::string& config_path) {
     Config config;
-    std::ifstream infile(config_path);
-    if (!infile) {
+    ConfigFile file;
+    if (!loadConfigFile(config_path, file)) {
         std::cerr << "错误: 配置文件 '" << config_path << "' 未找到。\n";
         exit(1);
     }
-    std::string line;
-    bool in_swap_pairs = false;
-    while (std::getline(infile, line)) {
-        line = trim(line);
-        if (line.empty() || line[0] == '#') continue;
-        if (line.rfind("file_path:", 0) == 0) {
-            std::string value = line.substr(std::string("file_path:").length());
-            value = trim(value);
-            if (!value.empty() && (value.front() == '"' || value.front() == '\'')) {
-                value = value.substr(1, value.size() - 2);
-            }
-            config.file_path = value;
-        } else if (line.rfind("swap_pairs:", 0) == 0) {
-            in_swap_pairs = true;
-        } else if (in_swap_pairs && line[0] == '-') {
-            // 期望格式：- [123, 456]
-            std::regex pair_regex("-\\s*\\[\\s*(\\d+)\\s*,\\s*(\\d+)\\s*\\]");
-            std::smatch match;
-            if (std::regex_search(line, match, pair_regex)) {
-                int num1 = std::stoi(match[1].str());
-                int num2 = std::stoi(match[2].str());
-                config.swap_pairs.push_back({num1, num2});
-            }
+    uint32_t swap_section = file.sectionId("swap_pairs");
+    auto add_target = [&](const std::string& path) {
+        if (!config.targets.empty() && config.targets.back().file_path.empty())
+            config.targets.back().file_path = path;
+        else
+            config.targets.push_back({path, {}});
+    };
+    // 按在文件中出现的顺序处理 file_path 和数对
+    size_t entry = 0;
+    for (size_t i = 0; i <= file.pairs.size(); i++) {
+        for (; entry < file.entries.size() && file.entries[entry].pairsBefore <= i; entry++) {
+            if (file.entries[entry].key == "file_path") add_target(file.entries[entry].value);
         }
+        if (i == file.pairs.size()) break;
+        const ConfigPair& pair = file.pairs[i];
+        if (pair.section != swap_section) continue;
+        if (config.targets.empty()) config.targets.emplace_back();
+        config.targets.back().swap_pairs.push_back({pair.first, pair.second});
     }
     return config;
 }
 
-std::vector<unsigned char> decimal_to_bytes_little_endian(int number) {
-    std::vector<unsigned char> bytes(4);
-    bytes[0] = static_cast<unsigned char>(number & 0xFF);
-    bytes[1] = static_cast<unsigned char>((number >> 8) & 0xFF);
-    bytes[2] = static_cast<unsigned char>((number >> 16) & 0xFF);
-    bytes[3] = static_cast<unsigned char>((number >> 24) & 0xFF);
-    return bytes;
-}
+// 所有交换代码在文件中的出现位置（允许重叠，升序）。建立时只扫描一遍文件；
+// 交换时直接改写 content，并只重新检查被改动字节附近的窗口，
+// 因此逐对交换的结果与每对都重新查找全部出现位置完全相同。
+class OccurrenceIndex {
+public:
+    OccurrenceIndex(std::vector<unsigned char>& content, const IdMatcher& matcher)
+        : content_(content), matcher_(matcher), positions_(matcher.size()) {
+        matcher_.scan(content_.data(), content_.size(), [&](size_t index, size_t pos) {
+            positions_[index].insert(positions_[index].end(), pos);
+            return true;
+        });
+    }
 
-std::vector<size_t> find_all_occurrences(const std::vector<unsigned char>& data, const std::vector<unsigned char>& pattern) {
-    std::vector<size_t> indices;
-    if (pattern.empty() || data.size() < pattern.size()) return indices;
-    auto it = data.begin();
-    while (it != data.end()) {
-        auto pos = std::search(it, data.end(), pattern.begin(), pattern.end());
-        if (pos == data.end())
-            break;
-        indices.push_back(std::distance(data.begin(), pos));
-        it = pos + 1;
-    }
-    return indices;
-}
+    // 按出现顺序把 code1 的第 i 次出现与 code2 的第 i 次出现互换，任一代码没有出现时返回 false
+    bool swap(int code1, int code2) {
+        int index1 = matcher_.find(static_cast<uint32_t>(code1));
+        int index2 = matcher_.find(static_cast<uint32_t>(code2));
+        if (index1 < 0 || index2 < 0 || positions_[index1].empty() || positions_[index2].empty())
+            return false;
+        size_t swap_count = std::min(positions_[index1].size(), positions_[index2].size());
+        std::vector<size_t> indices1(positions_[index1].begin(), std::next(positions_[index1].begin(), swap_count));
+        std::vector<size_t> indices2(positions_[index2].begin(), std::next(positions_[index2].begin(), swap_count));
+        for (size_t i = 0; i < swap_count; i++) {
+            forWindows(indices1[i], indices2[i], [&](size_t q) { unindex(q); });
+            for (size_t j = 0; j < 4; j++)
+                std::swap(content_[indices1[i] + j], content_[indices2[i] + j]);
+            forWindows(indices1[i], indices2[i], [&](size_t q) { reindex(q); });
+        }
+        return true;
+    }
+
+    const std::set<size_t>& positions(int code) const {
+        static const std::set<size_t> empty;
+        int index = matcher_.find(static_cast<uint32_t>(code));
+        return index < 0 ? empty : positions_[index];
+    }
 
-std::pair<std::vector<unsigned char>, bool> swap_hex_bytes(std::vector<unsigned char> content,
-                                                           const std::vector<unsigned char>& bytes1,
-                                                           const std::vector<unsigned char>& bytes2) {
-    if (bytes1.size() != bytes2.size()) {
-        std::cerr << "错误: 十六进制值长度不同，无法互换。\n";
-        return {content, false};
-    }
-    auto indices1 = find_all_occurrences(content, bytes1);
-    auto indices2 = find_all_occurrences(content, bytes2);
-    if (indices1.empty() || indices2.empty())
-        return {content, false};
-    size_t swap_count = std::min(indices1.size(), indices2.size());
-    for (size_t i = 0; i < swap_count; i++) {
-        size_t index1 = indices1[i];
-        size_t index2 = indices2[i];
-        for (size_t j = 0; j < bytes1.size(); j++) {
-            std::swap(content[index1 + j], content[index2 + j]);
+private:
+    // 与 [a, a + 4) 或 [b, b + 4) 相交的所有 4 字节窗口
+    template <class Fn>
+    void forWindows(size_t a, size_t b, Fn&& fn) {
+        for (size_t base : {a, b}) {
+            size_t from = base >= 3 ? base - 3 : 0;
+            for (size_t q = from; q <= base + 3 && q + 4 <= content_.size(); q++)
+                fn(q);
         }
     }
-    return {content, true};
-}
 
-fs::path find_file_in_dir(const fs::path& start_dir, const std::string& target_file_name) {
-    for (auto& p : fs::recursive_directory_iterator(start_dir)) {
-        if (fs::is_regular_file(p.path()) && p.path().filename() == target_file_name) {
-            return p.path();
+    int lookup(size_t q) const {
+        uint32_t value;
+        std::memcpy(&value, content_.data() + q, 4);
+        return matcher_.find(value);
+    }
+
+    void unindex(size_t q) {
+        int index = lookup(q);
+        if (index >= 0) positions_[index].erase(q);
+    }
+
+    void reindex(size_t q) {
+        int index = lookup(q);
+        if (index >= 0) positions_[index].insert(q);
+    }
+
+    std::vector<unsigned char>& content_;
+    const IdMatcher& matcher_;
+    std::vector<std::set<size_t>> positions_;
+};
+
+// 把全部交换对合成为一个置换，一次改写所有出现位置。
+// 交换对两边出现次数不同时逐对交换只会换掉一部分，出现位置互相重叠时改写会互相覆盖，
+// 这两种情况无法表示为置换，返回 false，由调用方改为逐对交换。
+// 改写的是原文件中已有的出现位置，不会把逐对交换时相邻字节偶然拼出的代码当作出现位置。
+bool apply_swap_permutation(std::vector<unsigned char>& content,
+                            const OccurrenceIndex& occurrences,
+                            const std::vector<std::pair<int, int>>& swap_pairs,
+                            std::vector<std::pair<int, int>>& failed_pairs,
+                            std::ostream& log) {
+    SwapPermutation permutation;
+    std::vector<std::pair<int, int>> failed;
+    for (const auto& pair : swap_pairs) {
+        size_t count1 = occurrences.positions(pair.first).size();
+        size_t count2 = occurrences.positions(pair.second).size();
+        if (count1 != count2) return false;
+        if (count1 == 0) {
+            failed.push_back(pair);
+            continue;
         }
+        permutation.swap(static_cast<uint32_t>(pair.first), static_cast<uint32_t>(pair.second));
+    }
+
+    std::vector<std::pair<size_t, uint32_t>> writes;
+    for (const auto& [slot, value] : permutation.changes()) {
+        for (size_t pos : occurrences.positions(static_cast<int>(slot)))
+            writes.emplace_back(pos, static_cast<uint32_t>(value));
+    }
+    std::sort(writes.begin(), writes.end());
+    for (size_t i = 1; i < writes.size(); i++) {
+        if (writes[i].first < writes[i - 1].first + 4) return false;
+    }
+
+    auto conflicts = permutation.conflicts();
+    if (!conflicts.empty()) {
+        log << "以下代码出现在多个交换对中，按配置顺序叠加交换：";
+        for (size_t i = 0; i < conflicts.size(); i++)
+            log << (i ? ", " : "") << conflicts[i];
+        log << "\n";
     }
-    return "";
+    for (const auto& [pos, value] : writes) {
+        for (size_t j = 0; j < 4; j++)
+            content[pos + j] = static_cast<unsigned char>((value >> (8 * j)) & 0xFF);
+    }
+    failed_pairs = std::move(failed);
+    return true;
 }
 
-int main() {
-    std::string config_path = "美化配置.yaml";
-    Config config = load_config(config_path);
-    if (config.file_path.empty()) {
-        std::cerr << "错误: 配置文件中缺少 file_path 字段。\n";
-        return 1;
+// 解包目录中 文件名 -> 路径 的缓存，保存在目录旁：解包数据/dat -> 解包数据/dat.names。
+// 同名文件取遍历时最先遇到的一个。缓存中的路径不存在（文件被移动或删除）或缓存里没有该文件名时，
+// 重新遍历目录并更新缓存，每次运行最多遍历一次。
+//
+// 文本格式：第一行 "GFPNAMES 1"，之后每行 "<文件名>\t<路径>"。
+class FileNameIndex {
+public:
+    explicit FileNameIndex(const fs::path& dir) : dir_(dir) {
+        std::string base = dir.string();
+        while (base.size() > 1 && (base.back() == '/' || base.back() == '\\')) base.pop_back();
+        cache_path_ = base + ".names";
+        load();
     }
-    fs::path file_path(config.file_path);
-    std::string target_file_name = file_path.filename().string();
 
-    fs::path source_dir = "解包数据/dat";
-    fs::path source_path = find_file_in_dir(source_dir, target_file_name);
-    if (source_path.empty()) {
-        std::cerr << "错误: 未在 '" << source_dir.string() << "' 中找到文件 '" << target_file_name << "'\n";
-        return 1;
+    // 找不到时返回空路径
+    fs::path find(const std::string& name) {
+        auto it = paths_.find(name);
+        if (it != paths_.end() && fs::is_regular_file(it->second)) return it->second;
+        if (!rebuilt_) {
+            rebuild();
+            it = paths_.find(name);
+            if (it != paths_.end()) return it->second;
+        }
+        return "";
     }
 
-    fs::path destination_dir = "打包/dat";
-    fs::path destination_path = destination_dir / target_file_name;
-    try {
-        if (!fs::exists(destination_dir))
-            fs::create_directories(destination_dir);
+private:
+    void load() {
+        std::ifstream in(cache_path_);
+        std::string line;
+        if (!in || !std::getline(in, line) || trim(line) != "GFPNAMES 1") return;
+        while (std::getline(in, line)) {
+            auto tab = line.find('\t');
+            if (tab == std::string::npos || tab == 0) continue;
+            paths_.emplace(line.substr(0, tab), fs::path(line.substr(tab + 1)));
+        }
+    }
 
+    void rebuild() {
+        rebuilt_ = true;
+        paths_.clear();
+        std::vector<std::pair<std::string, std::string>> entries;
+        for (auto& p : fs::recursive_directory_iterator(dir_)) {
+            if (!fs::is_regular_file(p.path())) continue;
+            std::string name = p.path().filename().string();
+            if (paths_.emplace(name, p.path()).second)
+                entries.emplace_back(name, p.path().string());
+        }
+        save(entries);
+    }
+
+    // 写入临时文件后替换；写入失败只影响下次运行的速度
+    void save(const std::vector<std::pair<std::string, std::string>>& entries) const {
+        std::string tmp_path = cache_path_ + ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::trunc);
+            if (!out) return;
+            out << "GFPNAMES 1\n";
+            for (const auto& [name, path] : entries)
+                out << name << '\t' << path << "\n";
+            if (!out) {
+                out.close();
+                std::remove(tmp_path.c_str());
+                return;
+            }
+        }
+        std::rename(tmp_path.c_str(), cache_path_.c_str());
+    }
+
+    fs::path dir_;
+    std::string cache_path_;
+    std::unordered_map<std::string, fs::path> paths_;
+    bool rebuilt_ = false;
+};
+
+// 单个目标的输出，全部目标处理完后按配置顺序打印
+struct TargetReport {
+    std::ostringstream out;
+    std::ostringstream err;
+    bool ok = false;
+};
+
+void beautify_target(const Target& target, const fs::path& source_path,
+                     const fs::path& destination_dir, TargetReport& report) {
+    std::ostream& out = report.out;
+    std::ostream& err = report.err;
+    fs::path destination_path = destination_dir / fs::path(target.file_path).filename();
+    try {
         fs::copy_file(source_path, destination_path, fs::copy_options::overwrite_existing);
-        std::cout << "文件 '" << source_path.string() << "' 已成功复制到 '" << destination_path.string() << "'\n";
+        out << "文件 '" << source_path.string() << "' 已成功复制到 '" << destination_path.string() << "'\n";
 
         std::ifstream infile(destination_path, std::ios::binary);
         if (!infile) {
-            std::cerr << "错误: 文件 '" << destination_path.string() << "' 打开失败。\n";
-            return 1;
+            err << "错误: 文件 '" << destination_path.string() << "' 打开失败。\n";
+            return;
         }
         std::vector<unsigned char> content((std::istreambuf_iterator<char>(infile)),
                                              std::istreambuf_iterator<char>());
         infile.close();
 
+        // 一次扫描记录所有交换代码的出现位置，之后逐对在原数据上交换
+        std::vector<int32_t> codes;
+        for (auto& pair : target.swap_pairs) {
+            codes.push_back(pair.first);
+            codes.push_back(pair.second);
+        }
+        IdMatcher matcher(codes);
+        OccurrenceIndex occurrences(content, matcher);
+
         std::vector<std::pair<int, int>> failed_pairs;
-        size_t total_pairs = config.swap_pairs.size();
-        size_t current_pair = 0;
-        for (auto& pair : config.swap_pairs) {
-            current_pair++;
-            std::cout << "处理第 " << current_pair << " 对，共 " << total_pairs << " 对...\n";
-            std::vector<unsigned char> bytes1 = decimal_to_bytes_little_endian(pair.first);
-            std::vector<unsigned char> bytes2 = decimal_to_bytes_little_endian(pair.second);
-            auto result = swap_hex_bytes(content, bytes1, bytes2);
-            content = result.first;
-            if (!result.second) {
-                failed_pairs.push_back(pair);
+        size_t total_pairs = target.swap_pairs.size();
+        out << "共 " << total_pairs << " 对，合并为一次改写...\n";
+        if (!apply_swap_permutation(content, occurrences, target.swap_pairs, failed_pairs, out)) {
+            // 无法合并时按顺序逐对交换
+            out << "部分交换对出现次数不一致或位置重叠，改为逐对交换。\n";
+            size_t current_pair = 0;
+            for (auto& pair : target.swap_pairs) {
+                current_pair++;
+                out << "处理第 " << current_pair << " 对，共 " << total_pairs << " 对...\n";
+                if (!occurrences.swap(pair.first, pair.second)) {
+                    failed_pairs.push_back(pair);
+                }
             }
         }
 
         std::ofstream outfile(destination_path, std::ios::binary);
         if (!outfile) {
-            std::cerr << "错误: 无法写入文件 '" << destination_path.string() << "'\n";
-            return 1;
+            err << "错误: 无法写入文件 '" << destination_path.string() << "'\n";
+            return;
         }
         outfile.write(reinterpret_cast<const char*>(content.data()), content.size());
         outfile.close();
-        std::cout << "成功修改美化文件 '" << destination_path.string() << "'\n";
+        out << "成功修改美化文件 '" << destination_path.string() << "'\n";
 
         if (!failed_pairs.empty()) {
-            std::cout << "\n以下值未修改完成，请检查配置是否正确：\n";
+            out << "\n以下值未修改完成，请检查配置是否正确：\n";
             for (auto& pair : failed_pairs) {
-                std::cout << pair.first << " ☞ " << pair.second << "\n";
+                out << pair.first << " ☞ " << pair.second << "\n";
             }
         } else {
-            std::cout << "\n所有美化值均已成功修改。\n";
+            out << "\n所有美化值均已成功修改。\n";
         }
+        report.ok = true;
     } catch (const fs::filesystem_error& e) {
-        std::cerr << "文件系统错误: " << e.what() << "\n";
-        return 1;
+        err << "文件系统错误: " << e.what() << "\n";
     } catch (const std::exception& e) {
-        std::cerr << "发生错误: " << e.what() << "\n";
+        err << "发生错误: " << e.what() << "\n";
+    }
+}
+
+int main() {
+    std::string config_path = "美化配置.yaml";
+    Config config = load_config(config_path);
+    if (config.targets.empty()) {
+        std::cerr << "错误: 配置文件中缺少 file_path 字段。\n";
         return 1;
     }
-    return 0;
+    size_t target_count = config.targets.size();
+    std::vector<TargetReport> reports(target_count);
+    std::vector<fs::path> source_paths(target_count);
+    fs::path source_dir = "解包数据/dat";
+    fs::path destination_dir = "打包/dat";
+    try {
+        // 先按顺序定位全部目标；同名目标会写到同一个输出文件，只处理第一个
+        FileNameIndex names(source_dir);
+        std::unordered_map<std::string, size_t> first_target;
+        for (size_t i = 0; i < target_count; i++) {
+            const Target& target = config.targets[i];
+            if (target.file_path.empty()) {
+                reports[i].err << "错误: 配置文件中缺少 file_path 字段。\n";
+                continue;
+            }
+            std::string target_file_name = fs::path(target.file_path).filename().string();
+            auto [it, inserted] = first_target.emplace(target_file_name, i);
+            if (!inserted) {
+                reports[i].err << "错误: 目标 '" << target_file_name << "' 与第 " << it->second + 1
+                               << " 个目标重复，已跳过。\n";
+                continue;
+            }
+            source_paths[i] = names.find(target_file_name);
+            if (source_paths[i].empty()) {
+                reports[i].err << "错误: 未在 '" << source_dir.string() << "' 中找到文件 '" << target_file_name << "'\n";
+            }
+        }
+        if (!fs::exists(destination_dir))
+            fs::create_directories(destination_dir);
+    } catch (const fs::filesystem_error& e) {
+        std::cerr << "文件系统错误: " << e.what() << "\n";
+        return 1;
+    }
+
+    // 各目标互不相关，按文件大小分配到多个线程同时处理
+    std::vector<size_t> runnable;
+    std::vector<uint64_t> weights;
+    for (size_t i = 0; i < target_count; i++) {
+        if (source_paths[i].empty()) continue;
+        std::error_code ec;
+        uint64_t size = fs::file_size(source_paths[i], ec);
+        runnable.push_back(i);
+        weights.push_back(ec ? 0 : size);
+    }
+    uint64_t total_bytes = 0;
+    for (uint64_t weight : weights) total_bytes += weight;
+    ProgressReporter progress;
+    progress.begin("美化 dat", runnable.size(), total_bytes);
+    if (runnable.size() == 1) {
+        size_t i = runnable[0];
+        beautify_target(config.targets[i], source_paths[i], destination_dir, reports[i]);
+        progress.add(1, weights[0]);
+    } else if (!runnable.empty()) {
+        WorkStealingPool pool(std::min(defaultThreadCount(), runnable.size()));
+        pool.run(weights, [&](size_t, size_t task) {
+            size_t i = runnable[task];
+            beautify_target(config.targets[i], source_paths[i], destination_dir, reports[i]);
+            progress.add(1, weights[task]);
+        });
+    }
+    progress.end();
+
+    int result = 0;
+    for (size_t i = 0; i < target_count; i++) {
+        if (target_count > 1) {
+            std::cout << (i ? "\n" : "") << "==== [" << i + 1 << "/" << target_count << "] "
+                      << config.targets[i].file_path << " ====\n";
+        }
+        std::cout << reports[i].out.str();
+        std::cout.flush();
+        std::cerr << reports[i].err.str();
+        if (!reports[i].ok) result = 1;
+    }
+    return result;
 }
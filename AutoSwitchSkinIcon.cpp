@@ -4,29 +4,31 @@
 #include <string>
 #include <vector>
 #include <filesystem>
-#include <regex>
 #include <set>
 #include <unordered_map>
 #include <stdexcept>
 #include <optional>
 #include <algorithm>
 #include <cstdlib>
-#include <thread>
-#include <future>
 #include <mutex>
+#include <memory>
+#include <cstdint>
+
+#include "ByteSearch.h"
+#include "IdMatcher.h"
+#include "WorkStealing.h"
+#include "HitHistory.h"
+#include "FilePatch.h"
+#include "Staging.h"
+#include "ConfigFile.h"
+#include "SkinLayout.h"
+#include "Progress.h"
 
 namespace fs = std::filesystem;
 
 std::set<std::string> modified_files;
 std::vector<std::pair<int, int>> not_found_pairs;
 
-std::string trim(const std::string &s) {
-    size_t start = s.find_first_not_of(" \t\r\n");
-    if (start == std::string::npos) return "";
-    size_t end = s.find_last_not_of(" \t\r\n");
-    return s.substr(start, end - start + 1);
-}
-
 std::string to_hex_string(const std::vector<unsigned char>& data) {
     std::ostringstream oss;
     oss << std::hex;
@@ -50,14 +52,6 @@ std::vector<unsigned char> hex_to_bytes(const std::string &hex) {
     return bytes;
 }
 
-std::string decimal_to_little_endian_hex(int number, int byte_length = 4) {
-    std::vector<unsigned char> bytes(byte_length);
-    for (int i = 0; i < byte_length; i++) {
-        bytes[i] = static_cast<unsigned char>((number >> (8 * i)) & 0xFF);
-    }
-    return to_hex_string(bytes);
-}
-
 std::vector<unsigned char> load_file_data(const std::string &file_path) {
     std::ifstream ifs(file_path, std::ios::binary);
     if (!ifs)
@@ -66,90 +60,38 @@ std::vector<unsigned char> load_file_data(const std::string &file_path) {
                                       std::istreambuf_iterator<char>());
 }
 
-std::vector<size_t> search_hex_positions_in_data(const std::vector<unsigned char>& data, const std::string &target_hex) {
-    std::vector<size_t> positions;
-    std::vector<unsigned char> pattern = hex_to_bytes(target_hex);
-    if (pattern.empty() || data.size() < pattern.size())
-        return positions;
-    auto it = data.begin();
-    while (it != data.end()) {
-        auto pos_it = std::search(it, data.end(), pattern.begin(), pattern.end());
-        if (pos_it == data.end())
-            break;
-        size_t pos = std::distance(data.begin(), pos_it);
-        positions.push_back(pos);
-        it = pos_it + 1;
-    }
-    return positions;
+MarkerIndex build_marker_index(const std::vector<unsigned char>& data,
+                               const std::string &hex_start,
+                               const std::string &hex_end) {
+    return buildMarkerIndex(data.data(), data.size(), hex_to_bytes(hex_start), hex_to_bytes(hex_end));
 }
 
 std::optional<std::string> extract_mapping_from_data(const std::vector<unsigned char>& data,
-                                                     const std::string &hex_start,
-                                                     const std::string &hex_end,
-                                                     size_t target_position) {
-    const size_t required_hex_length = 28;
-    size_t required_bytes = required_hex_length / 2;
-    auto positions_start = search_hex_positions_in_data(data, hex_start);
-    auto positions_end = search_hex_positions_in_data(data, hex_end);
-    if (positions_start.empty() || positions_end.empty())
-        return std::nullopt;
-    auto closest_start = *std::min_element(positions_start.begin(), positions_start.end(),
-        [target_position](size_t a, size_t b) {
-            return std::abs((int)a - (int)target_position) < std::abs((int)b - (int)target_position);
-        });
-    auto closest_end = *std::min_element(positions_end.begin(), positions_end.end(),
-        [target_position](size_t a, size_t b) {
-            return std::abs((int)a - (int)target_position) < std::abs((int)b - (int)target_position);
-        });
-    if (closest_start > closest_end)
-        std::swap(closest_start, closest_end);
-    size_t marker_length = hex_start.size() / 2;
-    if (closest_start + marker_length > data.size())
-        return std::nullopt;
-    size_t middle_length = closest_end - (closest_start + marker_length);
-    if (middle_length != required_bytes)
+                                                     const MarkerIndex &markers,
+                                                     size_t marker_length,
+                                                     uint64_t target_position) {
+    auto location = locateMapping(markers, marker_length, target_position);
+    if (!location.has_value() || location->second != kMappingLength)
         return std::nullopt;
-    std::vector<unsigned char> middle_data(data.begin() + closest_start + marker_length,
-                                             data.begin() + closest_end);
-    std::string mapping = to_hex_string(middle_data);
-    if (mapping.size() != required_hex_length)
-        return std::nullopt;
-    return mapping;
+    std::vector<unsigned char> middle_data(data.begin() + location->first,
+                                           data.begin() + location->first + location->second);
+    return to_hex_string(middle_data);
 }
 
-bool write_mapping(const std::string &file_path,
-                   const std::string &start_marker,
-                   const std::string &end_marker,
-                   size_t target_position,
+// 把新的映射记入补丁计划（按源文件读取），不直接写盘
+bool write_mapping(PatchPlan &plan,
+                   const std::string &file_path,
+                   const MarkerIndex &markers,
+                   size_t marker_length,
+                   uint64_t target_position,
                    const std::string &new_mapping) {
-    std::vector<unsigned char> data = load_file_data(file_path);
-    if (data.empty())
-        return false;
-    auto positions_start = search_hex_positions_in_data(data, start_marker);
-    auto positions_end = search_hex_positions_in_data(data, end_marker);
-    if (positions_start.empty() || positions_end.empty())
+    auto location = locateMapping(markers, marker_length, target_position);
+    if (!location.has_value())
         return false;
-    auto closest_start = *std::min_element(positions_start.begin(), positions_start.end(),
-        [target_position](size_t a, size_t b) {
-            return std::abs((int)a - (int)target_position) < std::abs((int)b - (int)target_position);
-        });
-    auto closest_end = *std::min_element(positions_end.begin(), positions_end.end(),
-        [target_position](size_t a, size_t b) {
-            return std::abs((int)a - (int)target_position) < std::abs((int)b - (int)target_position);
-        });
-    if (closest_start > closest_end)
-        std::swap(closest_start, closest_end);
-    size_t marker_length = start_marker.size() / 2;
-    size_t original_length = closest_end - (closest_start + marker_length);
     auto new_bytes = hex_to_bytes(new_mapping);
-    if (new_bytes.size() != original_length)
+    if (new_bytes.size() != location->second)
         throw std::runtime_error("新的映射长度与原映射长度不匹配。");
-    std::copy(new_bytes.begin(), new_bytes.end(), data.begin() + closest_start + marker_length);
-    std::ofstream ofs(file_path, std::ios::binary);
-    if (!ofs)
-        return false;
-    ofs.write(reinterpret_cast<const char*>(data.data()), data.size());
-    return true;
+    return plan.write(file_path, location->first, new_bytes);
 }
 
 struct Config {
@@ -161,60 +103,17 @@ struct Config {
 
 Config load_config(const std::string &config_file) {
     Config cfg;
-    std::ifstream ifs(config_file);
-    if (!ifs) {
+    ConfigFile file;
+    if (!loadConfigFile(config_file, file)) {
         std::exit(1);
     }
-    std::string line;
-    bool in_targets = false;
-    bool in_hex_markers = false;
-    std::regex target_regex("-\\s*\\[\\s*(\\d+)\\s*,\\s*(\\d+)\\s*\\]");
-    std::regex key_value_regex("^\\s*(\\w+)\\s*:\\s*\"(.*?)\"");
-    std::regex key_value_noquote("^\\s*(\\w+)\\s*:\\s*(\\S+)");
-    while (std::getline(ifs, line)) {
-        line = trim(line);
-        if (line.empty() || line[0] == '#')
-            continue;
-        if (line.rfind("folder_path:", 0) == 0) {
-            std::smatch m;
-            if (std::regex_search(line, m, key_value_regex))
-                cfg.folder_path = m[2];
-            else if (std::regex_search(line, m, key_value_noquote))
-                cfg.folder_path = m[2];
-            in_targets = false;
-            in_hex_markers = false;
-        } else if (line.rfind("search_targets:", 0) == 0) {
-            in_targets = true;
-            in_hex_markers = false;
-        } else if (line.rfind("hex_markers:", 0) == 0) {
-            in_hex_markers = true;
-            in_targets = false;
-        } else if (in_targets && line[0] == '-') {
-            std::smatch m;
-            if (std::regex_search(line, m, target_regex)) {
-                int a = std::stoi(m[1].str());
-                int b = std::stoi(m[2].str());
-                cfg.search_targets.push_back({a, b});
-            }
-        } else if (in_hex_markers) {
-            std::smatch m;
-            if (std::regex_search(line, m, key_value_regex)) {
-                std::string key = m[1];
-                std::string value = m[2];
-                if (key == "start")
-                    cfg.hex_marker_start = value;
-                else if (key == "end")
-                    cfg.hex_marker_end = value;
-            } else if (std::regex_search(line, m, key_value_noquote)) {
-                std::string key = m[1];
-                std::string value = m[2];
-                if (key == "start")
-                    cfg.hex_marker_start = value;
-                else if (key == "end")
-                    cfg.hex_marker_end = value;
-            }
-        }
-    }
+    if (const std::string *folder = file.value("folder_path"))
+        cfg.folder_path = *folder;
+    cfg.search_targets = file.pairsIn("search_targets");
+    if (const std::string *start = file.value("hex_markers", "start"))
+        cfg.hex_marker_start = *start;
+    if (const std::string *end = file.value("hex_markers", "end"))
+        cfg.hex_marker_end = *end;
     return cfg;
 }
 
@@ -237,142 +136,200 @@ void prepare_destination() {
 
 struct MappingInfo {
     std::string file;
-    size_t target_position;
+    uint64_t target_position;
     std::string mapping;
+    std::shared_ptr<const MarkerIndex> markers;  // 同一文件中的代码共用
 };
 
 //
 // 多线程版本：扫描指定目录及其子目录中所有文件，对每个文件尝试提取目标代码的映射信息。
+// 每个文件只扫描一遍，同时匹配全部代码并记录每个代码的第一次出现位置。
+// 每个代码取目录遍历顺序中最靠前的、能提取出映射的文件（与 IdCatalog 相同）；排在它前面的文件都扫描完后
+// 这个代码就确定了，全部代码确定后取消剩余的任务。
+// history_path 不为空时只用命中记录调度：以往命中过的文件先扫描，同一组代码和特征值下未命中且没有变化的文件跳过。
+// 两者都不影响取哪个文件，结果与不使用记录时相同。
 // 返回一个映射：code -> MappingInfo
 //
 std::unordered_map<int, MappingInfo> scan_all_files_mt(const std::string &root_path,
                                                        const std::vector<std::pair<int, int>> &targets,
                                                        const std::string &hex_start,
-                                                       const std::string &hex_end) {
+                                                       const std::string &hex_end,
+                                                       const std::string &history_path = "") {
     std::set<int> codes_set;
     for (const auto &group : targets) {
         codes_set.insert(group.first);
         codes_set.insert(group.second);
     }
+    const IdMatcher matcher(std::vector<int32_t>(codes_set.begin(), codes_set.end()));
     std::vector<std::string> all_files;
     for (auto &entry : fs::recursive_directory_iterator(root_path)) {
         if (fs::is_regular_file(entry.path()))
             all_files.push_back(entry.path().string());
     }
-    unsigned int num_threads = std::thread::hardware_concurrency();
-    if (num_threads == 0)
-        num_threads = 4;
-    size_t total_files = all_files.size();
-    size_t chunk_size = (total_files + num_threads - 1) / num_threads;
-    std::vector<std::future<std::unordered_map<int, MappingInfo>>> futures;
-    for (size_t i = 0; i < num_threads; i++) {
-        auto start_it = all_files.begin() + i * chunk_size;
-        auto end_it = (i == num_threads - 1) ? all_files.end() : start_it + chunk_size;
-        std::vector<std::string> chunk(start_it, end_it);
-        futures.push_back(std::async(std::launch::async, [chunk, &codes_set, &hex_start, &hex_end]() -> std::unordered_map<int, MappingInfo> {
-            std::unordered_map<int, MappingInfo> local_mapping;
-            for (const auto &file_path : chunk) {
-                auto data = load_file_data(file_path);
-                if (data.empty())
+    // 未命中结果只对同一组代码和特征值有效
+    uint64_t codes_hash = 1469598103934665603ull;
+    for (int code : codes_set) {
+        codes_hash ^= static_cast<uint32_t>(code);
+        codes_hash *= 1099511628211ull;
+    }
+    const std::string history_key = hex_start + " " + hex_end + " " + std::to_string(codes_hash);
+    HitHistory history;
+    if (!history_path.empty())
+        history.load(history_path, history_key);
+
+    const size_t total_files = all_files.size();
+    const size_t code_count = matcher.size();
+    std::vector<uint64_t> sizes(total_files);
+    uint64_t total_bytes = 0;
+    for (size_t i = 0; i < total_files; i++) {
+        std::error_code ec;
+        sizes[i] = fs::file_size(all_files[i], ec);
+        if (ec) sizes[i] = 0;
+        total_bytes += sizes[i];
+    }
+    // 全部代码确定后剩余的文件不再扫描，进度停在取消时的位置
+    ProgressReporter progress;
+    progress.begin("扫描 uexp", total_files, total_bytes);
+    std::mutex mutex;
+    std::vector<size_t> best(code_count, bytesearch::npos);  // 每个代码当前结果所在的文件序号
+    std::vector<MappingInfo> found(code_count);
+    std::vector<char> done(total_files, 0);
+    size_t prefix = 0;  // 序号小于 prefix 的文件都已扫描完
+    size_t unresolved = code_count;
+
+    WorkStealingPool pool;
+    // 权重按文件顺序递减，各线程大致按顺序取任务；命中过的文件排在所有文件之前。
+    // 跳过哪些文件在启动线程前确定，工作线程只读 skip
+    std::vector<char> skip(total_files, 0);
+    std::vector<uint64_t> weights(total_files);
+    for (size_t i = 0; i < total_files; i++) {
+        weights[i] = total_files - i;
+        if (history_path.empty())
+            continue;
+        if (history.hits(all_files[i]) > 0)
+            weights[i] += total_files;
+        else if (history.knownMiss(all_files[i]))
+            skip[i] = 1;
+    }
+    std::vector<std::vector<size_t>> first_hits(pool.size(), std::vector<size_t>(code_count));
+    std::vector<std::vector<char>> wanted(pool.size(), std::vector<char>(code_count));
+    pool.run(weights, [&](size_t worker, size_t task) {
+        std::vector<size_t> &first_hit = first_hits[worker];
+        std::vector<char> &want = wanted[worker];
+        // 只检查结果还可能被这个文件取代的代码
+        size_t remaining = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t index = 0; index < code_count; index++) {
+                want[index] = best[index] > task;
+                remaining += want[index];
+            }
+        }
+        std::vector<std::pair<size_t, MappingInfo>> local;
+        // 全部代码都检查过的文件才能记为未命中
+        const bool full_check = remaining == code_count;
+        if (remaining > 0 && !skip[task]) {
+            const std::string &file_path = all_files[task];
+            auto data = load_file_data(file_path);
+            std::fill(first_hit.begin(), first_hit.end(), bytesearch::npos);
+            // 需要的代码都出现过后提前结束扫描
+            matcher.scan(data.data(), data.size(), [&](size_t index, size_t pos) {
+                if (!want[index] || first_hit[index] != bytesearch::npos)
+                    return true;
+                first_hit[index] = pos;
+                return --remaining > 0;
+            });
+            // 有命中时才建立该文件的特征值索引
+            std::shared_ptr<const MarkerIndex> markers;
+            for (size_t index = 0; index < code_count; index++) {
+                if (first_hit[index] == bytesearch::npos)
                     continue;
-                for (int code : codes_set) {
-                    if (local_mapping.find(code) != local_mapping.end())
-                        continue;
-                    std::string code_hex = decimal_to_little_endian_hex(code, 4);
-                    auto positions = search_hex_positions_in_data(data, code_hex);
-                    if (positions.empty())
-                        continue;
-                    size_t target_pos = positions[0];
-                    auto mappingOpt = extract_mapping_from_data(data, hex_start, hex_end, target_pos);
-                    if (mappingOpt.has_value()) {
-                        local_mapping[code] = MappingInfo{ fs::absolute(file_path).string(), target_pos, mappingOpt.value() };
-                    }
+                if (!markers)
+                    markers = std::make_shared<const MarkerIndex>(build_marker_index(data, hex_start, hex_end));
+                uint64_t target_pos = first_hit[index];
+                auto mappingOpt = extract_mapping_from_data(data, *markers, hex_start.size() / 2, target_pos);
+                if (mappingOpt.has_value()) {
+                    local.emplace_back(index, MappingInfo{ fs::absolute(file_path).string(), target_pos,
+                                                           mappingOpt.value(), markers });
                 }
             }
-            return local_mapping;
-        }));
-    }
-    std::unordered_map<int, MappingInfo> mapping_info;
-    for (auto &fut : futures) {
-        auto local_map = fut.get();
-        for (const auto &p : local_map) {
-            if (mapping_info.find(p.first) == mapping_info.end())
-                mapping_info[p.first] = p.second;
+            if (!history_path.empty() && (full_check || !local.empty()))
+                history.record(file_path, !local.empty());
         }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &[index, info] : local) {
+            if (task < best[index]) {
+                if (best[index] == bytesearch::npos)
+                    unresolved--;
+                best[index] = task;
+                found[index] = std::move(info);
+            }
+        }
+        progress.add(1, sizes[task]);
+        done[task] = 1;
+        while (prefix < total_files && done[prefix])
+            prefix++;
+        if (unresolved == 0 &&
+            std::all_of(best.begin(), best.end(), [&](size_t b) { return b < prefix; }))
+            pool.cancel();
+    });
+    progress.end();
+    if (!history_path.empty())
+        history.save(history_path, history_key, all_files);
+
+    std::unordered_map<int, MappingInfo> mapping_info;
+    for (size_t index = 0; index < code_count; index++) {
+        if (best[index] != bytesearch::npos)
+            mapping_info[matcher.id(index)] = std::move(found[index]);
     }
     return mapping_info;
 }
 
 //
-// 多线程版本：扫描所有文件，对于配置中每组目标代码（2个数字），即使映射分布在不同文件中，也交换它们的映射数据，并写回原文件。
-// 为防止多个线程同时写入同一文件，使用了每个文件对应的互斥量（按文件名排序锁定，避免死锁）。
+// 扫描所有文件，对于配置中每组目标代码（2个数字），即使映射分布在不同文件中，也交换它们的映射数据。
+// 交换使用扫描时取得的映射值，只在内存中记入补丁计划；全部处理完后每个涉及的文件只打开、写入一次，
+// 因此耗时取决于涉及的文件数而不是交换对数，也不再需要按文件加锁。
 //
 void process_cross_file_swap_mt(const std::string &root_path,
                                 const std::vector<std::pair<int, int>> &targets,
                                 const std::string &hex_start,
-                                const std::string &hex_end) {
-    auto mapping_info = scan_all_files_mt(root_path, targets, hex_start, hex_end);
-    // 为所有参与交换的文件建立互斥量
-    std::unordered_map<std::string, std::mutex> file_mutexes;
+                                const std::string &hex_end,
+                                LazyStaging *staging = nullptr) {
+    // 命中记录只保存在解包数据旁边，不写进打包目录
+    auto mapping_info = scan_all_files_mt(root_path, targets, hex_start, hex_end,
+                                          staging ? hitHistoryPathFor(root_path) : "");
+    const size_t marker_length = hex_start.size() / 2;
+    PatchPlan plan;
+    std::set<std::string> planned_files;
     for (const auto &group : targets) {
-        if (mapping_info.find(group.first) != mapping_info.end())
-            file_mutexes[mapping_info[group.first].file];
-        if (mapping_info.find(group.second) != mapping_info.end())
-            file_mutexes[mapping_info[group.second].file];
-    }
-    std::mutex global_mutex; // 用于保护 not_found_pairs 和 modified_files 的更新
-    unsigned int num_threads = std::thread::hardware_concurrency();
-    if (num_threads == 0)
-        num_threads = 4;
-    size_t total_targets = targets.size();
-    size_t chunk_size = (total_targets + num_threads - 1) / num_threads;
-    std::vector<std::future<void>> futures;
-    for (size_t i = 0; i < num_threads; i++) {
-        size_t start_index = i * chunk_size;
-        size_t end_index = std::min(start_index + chunk_size, total_targets);
-        futures.push_back(std::async(std::launch::async, [start_index, end_index, &targets, &mapping_info, &hex_start, &hex_end, &file_mutexes, &global_mutex]() {
-            for (size_t j = start_index; j < end_index; j++) {
-                int code1 = targets[j].first, code2 = targets[j].second;
-                if (mapping_info.find(code1) == mapping_info.end() || mapping_info.find(code2) == mapping_info.end()) {
-                    std::lock_guard<std::mutex> lock(global_mutex);
-                    not_found_pairs.push_back({code1, code2});
-                    continue;
-                }
-                const MappingInfo &mi1 = mapping_info.at(code1);
-                const MappingInfo &mi2 = mapping_info.at(code2);
-                // 如果两个映射在同一文件中，仅锁定该文件的互斥量
-                if (mi1.file == mi2.file) {
-                    std::lock_guard<std::mutex> lock(file_mutexes[mi1.file]);
-                    try {
-                        if (write_mapping(mi1.file, hex_start, hex_end, mi1.target_position, mi2.mapping))
-                            modified_files.insert(fs::absolute(mi1.file).string());
-                        if (write_mapping(mi2.file, hex_start, hex_end, mi2.target_position, mi1.mapping))
-                            modified_files.insert(fs::absolute(mi2.file).string());
-                    } catch (const std::exception &) {
-                        continue;
-                    }
-                } else {
-                    // 为避免死锁，按文件名顺序锁定两个文件的互斥量
-                    std::string fileA = mi1.file, fileB = mi2.file;
-                    if (fileA > fileB)
-                        std::swap(fileA, fileB);
-                    std::unique_lock<std::mutex> lock1(file_mutexes[fileA], std::defer_lock);
-                    std::unique_lock<std::mutex> lock2(file_mutexes[fileB], std::defer_lock);
-                    std::lock(lock1, lock2);
-                    try {
-                        if (write_mapping(mi1.file, hex_start, hex_end, mi1.target_position, mi2.mapping))
-                            modified_files.insert(fs::absolute(mi1.file).string());
-                        if (write_mapping(mi2.file, hex_start, hex_end, mi2.target_position, mi1.mapping))
-                            modified_files.insert(fs::absolute(mi2.file).string());
-                    } catch (const std::exception &) {
-                        continue;
-                    }
-                }
-            }
-        }));
+        int code1 = group.first, code2 = group.second;
+        if (mapping_info.find(code1) == mapping_info.end() || mapping_info.find(code2) == mapping_info.end()) {
+            not_found_pairs.push_back({code1, code2});
+            continue;
+        }
+        const MappingInfo &mi1 = mapping_info.at(code1);
+        const MappingInfo &mi2 = mapping_info.at(code2);
+        try {
+            if (write_mapping(plan, mi1.file, *mi1.markers, marker_length, mi1.target_position, mi2.mapping))
+                planned_files.insert(mi1.file);
+            if (write_mapping(plan, mi2.file, *mi2.markers, marker_length, mi2.target_position, mi1.mapping))
+                planned_files.insert(mi2.file);
+        } catch (const std::exception &) {
+            continue;
+        }
     }
-    for (auto &f : futures) {
-        f.get();
+
+    // 使用延迟暂存时，扫描的是解包数据，写入前才把文件复制到打包目录
+    auto staged = [staging](const std::string &file) {
+        return staging ? staging->materialize(file) : file;
+    };
+    std::set<std::string> failed;
+    for (const auto &file : plan.commitInPlace(staged))
+        failed.insert(file);
+    for (const auto &file : planned_files) {
+        if (failed.count(file))
+            continue;
+        modified_files.insert(fs::absolute(staged(file)).string());
     }
 }
 
@@ -401,9 +358,21 @@ int main() {
     Config config = load_config(config_file);
     if (config.folder_path.empty())
         return 1;
-    prepare_destination();
-    process_cross_file_swap_mt(config.folder_path, config.search_targets,
-                               config.hex_marker_start, config.hex_marker_end);
+    // folder_path 就是打包目录时直接扫描解包数据，只复制真正修改的文件；否则保持整体复制
+    LazyStaging staging("解包数据/uexp", "打包/uexp", true);
+    // 打包目录可能还不存在，按规范化后的路径比较；只有直接扫描时才清空打包目录，整体复制由 prepare_destination 完成
+    std::error_code ec;
+    bool lazy = fs::exists(staging.sourceRoot()) &&
+                fs::weakly_canonical(config.folder_path, ec) == fs::weakly_canonical(staging.destinationRoot(), ec);
+    if (lazy) {
+        staging.reset();
+        process_cross_file_swap_mt(staging.sourceRoot().string(), config.search_targets,
+                                   config.hex_marker_start, config.hex_marker_end, &staging);
+    } else {
+        prepare_destination();
+        process_cross_file_swap_mt(config.folder_path, config.search_targets,
+                                   config.hex_marker_start, config.hex_marker_end);
+    }
     move_and_cleanup(config.folder_path);
     return 0;
 }
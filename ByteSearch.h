@@ -0,0 +1,176 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BYTESEARCH_X86 1
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define BYTESEARCH_NEON 1
+#endif
+
+// 字节串查找内核：先用 SIMD 同时比较模式的首字节和尾字节筛出候选位置，再校验中间部分。
+// x86 上使用 SSE2（运行时支持时切换到 AVX2），ARM 上使用 NEON，其他平台退回 memchr。
+// 2 字节特征值和 4 字节代码有编译期特化，首尾字节比较即可确定或只需一次定长比较。
+namespace bytesearch {
+
+constexpr size_t npos = static_cast<size_t>(-1);
+
+namespace detail {
+
+// N 为 0 表示运行期长度 m
+template <size_t N>
+inline bool verify(const unsigned char* p, const unsigned char* pattern, size_t m) {
+    if constexpr (N == 1 || N == 2) {
+        return true;
+    } else if constexpr (N > 2) {
+        return std::memcmp(p + 1, pattern + 1, N - 2) == 0;
+    } else {
+        return m <= 2 || std::memcmp(p + 1, pattern + 1, m - 2) == 0;
+    }
+}
+
+template <size_t N>
+size_t scalarFind(const unsigned char* data, size_t length,
+                  const unsigned char* pattern, size_t m, size_t start) {
+    const unsigned char first = pattern[0];
+    const unsigned char last = pattern[m - 1];
+    size_t i = start;
+    while (i + m <= length) {
+        const void* hit = std::memchr(data + i, first, length - m + 1 - i);
+        if (!hit) return npos;
+        i = static_cast<size_t>(static_cast<const unsigned char*>(hit) - data);
+        if (data[i + m - 1] == last && verify<N>(data + i, pattern, m)) return i;
+        i++;
+    }
+    return npos;
+}
+
+#if defined(BYTESEARCH_X86)
+
+template <size_t N>
+size_t sse2Find(const unsigned char* data, size_t length,
+                const unsigned char* pattern, size_t m, size_t start) {
+    const __m128i first = _mm_set1_epi8(static_cast<char>(pattern[0]));
+    const __m128i last = _mm_set1_epi8(static_cast<char>(pattern[m - 1]));
+    size_t i = start;
+    for (; i + m - 1 + 16 <= length; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + m - 1));
+        unsigned mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+        while (mask) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (verify<N>(data + i + bit, pattern, m)) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return scalarFind<N>(data, length, pattern, m, i);
+}
+
+template <size_t N>
+__attribute__((target("avx2")))
+size_t avx2Find(const unsigned char* data, size_t length,
+                const unsigned char* pattern, size_t m, size_t start) {
+    const __m256i first = _mm256_set1_epi8(static_cast<char>(pattern[0]));
+    const __m256i last = _mm256_set1_epi8(static_cast<char>(pattern[m - 1]));
+    size_t i = start;
+    for (; i + m - 1 + 32 <= length; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + m - 1));
+        uint32_t mask = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+        while (mask) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (verify<N>(data + i + bit, pattern, m)) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return sse2Find<N>(data, length, pattern, m, i);
+}
+
+inline bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+#elif defined(BYTESEARCH_NEON)
+
+template <size_t N>
+size_t neonFind(const unsigned char* data, size_t length,
+                const unsigned char* pattern, size_t m, size_t start) {
+    const uint8x16_t first = vdupq_n_u8(pattern[0]);
+    const uint8x16_t last = vdupq_n_u8(pattern[m - 1]);
+    size_t i = start;
+    for (; i + m - 1 + 16 <= length; i += 16) {
+        uint8x16_t eq = vandq_u8(vceqq_u8(vld1q_u8(data + i), first),
+                                 vceqq_u8(vld1q_u8(data + i + m - 1), last));
+        // 每个字节压缩成 4 位，得到 64 位掩码
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (mask) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctzll(mask)) >> 2;
+            if (verify<N>(data + i + bit, pattern, m)) return i + bit;
+            mask &= ~(uint64_t(0xF) << (bit * 4));
+        }
+    }
+    return scalarFind<N>(data, length, pattern, m, i);
+}
+
+#endif
+
+template <size_t N>
+inline size_t find(const unsigned char* data, size_t length,
+                   const unsigned char* pattern, size_t m, size_t start) {
+#if defined(BYTESEARCH_X86)
+    if (hasAvx2()) return avx2Find<N>(data, length, pattern, m, start);
+    return sse2Find<N>(data, length, pattern, m, start);
+#elif defined(BYTESEARCH_NEON)
+    return neonFind<N>(data, length, pattern, m, start);
+#else
+    return scalarFind<N>(data, length, pattern, m, start);
+#endif
+}
+
+}  // namespace detail
+
+// 在 [data, data + length) 中从 start 开始查找 pattern，返回首次出现的位置，找不到返回 npos
+inline size_t findBytes(const unsigned char* data, size_t length,
+                        const unsigned char* pattern, size_t m, size_t start = 0) {
+    if (m == 0 || length < m || start > length - m) return npos;
+    switch (m) {
+        case 2: return detail::find<2>(data, length, pattern, 2, start);
+        case 4: return detail::find<4>(data, length, pattern, 4, start);
+        default: return detail::find<0>(data, length, pattern, m, start);
+    }
+}
+
+// 编译期定长版本，用于已知长度的特征值和代码
+template <size_t N>
+inline size_t findBytesFixed(const unsigned char* data, size_t length,
+                             const unsigned char* pattern, size_t start = 0) {
+    static_assert(N > 0, "pattern length must be positive");
+    if (length < N || start > length - N) return npos;
+    return detail::find<N>(data, length, pattern, N, start);
+}
+
+inline size_t findBytes(const std::vector<unsigned char>& data,
+                        const std::vector<unsigned char>& pattern, size_t start = 0) {
+    return findBytes(data.data(), data.size(), pattern.data(), pattern.size(), start);
+}
+
+// 依次回调每个出现位置（允许重叠）；fn 返回 false 时提前结束
+template <class Fn>
+inline void forEachMatch(const unsigned char* data, size_t length,
+                         const unsigned char* pattern, size_t m, Fn&& fn) {
+    size_t pos = findBytes(data, length, pattern, m, 0);
+    while (pos != npos) {
+        if (!fn(pos)) return;
+        pos = findBytes(data, length, pattern, m, pos + 1);
+    }
+}
+
+}  // namespace bytesearch
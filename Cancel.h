@@ -0,0 +1,21 @@
+#pragma once
+
+#include <atomic>
+
+// 取消当前运行。常驻服务（ToolServer.h）在运行途中客户端断开时设置，每次运行开始前清除。
+// 线程池（WorkStealing.h）不再执行剩余任务并在 wait() 中抛出 RunCancelled，ProgressReporter 开始新阶段时同样抛出，
+// 工具因此停在下一个扫描阶段的边界上，不会带着不完整的扫描结果继续写文件；服务进程和其中的缓存保留。
+// RunCancelled 不派生自 std::exception，工具里捕获 std::exception 的代码不会把它当作普通错误吞掉。
+
+struct RunCancelled {};
+
+inline std::atomic<bool>& runCancelFlag() {
+    static std::atomic<bool> flag{false};
+    return flag;
+}
+
+inline bool runCancelled() { return runCancelFlag().load(std::memory_order_relaxed); }
+
+inline void throwIfRunCancelled() {
+    if (runCancelled()) throw RunCancelled();
+}
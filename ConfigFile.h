@@ -0,0 +1,321 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+// 各工具共用的 yaml 配置读取。只支持这些配置实际用到的写法：
+//   key: value          键值，值两端的引号会去掉
+//   section:            开始一个段（如 swap_pairs、hex_markers），之后的键值和数对都属于这个段
+//   - [123, 456]        段中的数对
+// 逐行手工解析，不使用 std::regex。
+//
+// 解析结果缓存在配置旁边的二进制文件中（cloth.yaml -> cloth.yaml.cache），配置的大小和内容哈希都相同时直接读取缓存。
+// 不只比较大小和修改时间：同样长度的改写（如 AutoMarker 更新特征值）可能落在同一个时间戳精度内，
+// 复制或解包也会还原修改时间，这些情况下只有内容哈希能发现变化。配置原文每次都要读一遍，缓存省下的是解析。
+//
+// 缓存格式（小端）：
+//   ConfigCacheHeader
+//   uint32_t[sectionCount * 2]          段名：字符串偏移、长度（0 号段为顶层，名字为空）
+//   uint32_t[entryCount * 6]            键值：段号、键偏移、键长度、值偏移、值长度、之前的数对个数
+//   int32_t[pairCount * 3]              数对：第一个数、第二个数、段号
+//   char[stringsSize]                   字符串
+
+constexpr uint32_t kConfigCacheVersion = 4;
+constexpr char kConfigCacheMagic[8] = {'G', 'F', 'P', 'C', 'O', 'N', 'F', '\0'};
+
+struct ConfigCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint32_t entryCount;
+    uint32_t pairCount;
+    uint64_t stringsSize;
+    uint64_t size;
+    uint64_t hash;
+};
+
+struct ConfigEntry {
+    uint32_t section;
+    std::string key;
+    std::string value;
+    uint32_t pairsBefore;  // 这个键之前出现的数对个数，用于把数对分给前面的键（如多个 file_path）
+};
+
+struct ConfigPair {
+    int32_t first;
+    int32_t second;
+    uint32_t section;
+};
+
+struct ConfigFile {
+    std::vector<std::string> sections{""};
+    std::vector<ConfigEntry> entries;
+    std::vector<ConfigPair> pairs;
+
+    // 段号，不存在时返回 UINT32_MAX
+    uint32_t sectionId(std::string_view name) const {
+        for (size_t i = 0; i < sections.size(); i++)
+            if (sections[i] == name) return static_cast<uint32_t>(i);
+        return UINT32_MAX;
+    }
+
+    // 任意段中最后一次出现的 key
+    const std::string* value(std::string_view key) const {
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+            if (it->key == key) return &it->value;
+        return nullptr;
+    }
+
+    // section 段中最后一次出现的 key
+    const std::string* value(std::string_view section, std::string_view key) const {
+        uint32_t id = sectionId(section);
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+            if (it->section == id && it->key == key) return &it->value;
+        return nullptr;
+    }
+
+    std::vector<std::pair<int, int>> pairsIn(std::string_view section) const {
+        std::vector<std::pair<int, int>> result;
+        uint32_t id = sectionId(section);
+        for (const auto& p : pairs)
+            if (p.section == id) result.emplace_back(p.first, p.second);
+        return result;
+    }
+};
+
+inline uint64_t configHash(const char* data, size_t n) {
+    uint64_t h = 1469598103934665603ull ^ n;
+    for (size_t i = 0; i < n; i++) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+namespace config_detail {
+
+inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+inline std::string_view trimView(std::string_view s) {
+    size_t b = 0, e = s.size();
+    while (b < e && isSpace(s[b])) b++;
+    while (e > b && isSpace(s[e - 1])) e--;
+    return s.substr(b, e - b);
+}
+
+inline void skipSpaces(std::string_view s, size_t& i) {
+    while (i < s.size() && isSpace(s[i])) i++;
+}
+
+// 非负十进制整数，超出 int 范围视为无效
+inline bool parseNumber(std::string_view s, size_t& i, int32_t& out) {
+    size_t begin = i;
+    uint64_t v = 0;
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+        v = v * 10 + static_cast<uint64_t>(s[i] - '0');
+        if (v > INT32_MAX) return false;
+        i++;
+    }
+    out = static_cast<int32_t>(v);
+    return i > begin;
+}
+
+// - [a, b]
+inline bool parsePair(std::string_view line, int32_t& a, int32_t& b) {
+    size_t i = 1;
+    skipSpaces(line, i);
+    if (i >= line.size() || line[i++] != '[') return false;
+    skipSpaces(line, i);
+    if (!parseNumber(line, i, a)) return false;
+    skipSpaces(line, i);
+    if (i >= line.size() || line[i++] != ',') return false;
+    skipSpaces(line, i);
+    if (!parseNumber(line, i, b)) return false;
+    skipSpaces(line, i);
+    return i < line.size() && line[i] == ']';
+}
+
+inline bool isKeyChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+inline std::string_view unquote(std::string_view v) {
+    if (!v.empty() && (v.front() == '"' || v.front() == '\'')) {
+        char quote = v.front();
+        v.remove_prefix(1);
+        if (!v.empty() && v.back() == quote) v.remove_suffix(1);
+    }
+    return v;
+}
+
+}  // namespace config_detail
+
+inline void parseConfigText(std::string_view text, ConfigFile& out) {
+    using namespace config_detail;
+    out = ConfigFile();
+    uint32_t section = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string_view::npos) eol = text.size();
+        std::string_view line = trimView(text.substr(pos, eol - pos));
+        pos = eol + 1;
+        if (line.empty() || line[0] == '#') continue;
+        if (line[0] == '-') {
+            int32_t a, b;
+            if (section != 0 && parsePair(line, a, b)) out.pairs.push_back({a, b, section});
+            continue;
+        }
+        size_t k = 0;
+        while (k < line.size() && isKeyChar(line[k])) k++;
+        size_t colon = k;
+        skipSpaces(line, colon);
+        if (k == 0 || colon >= line.size() || line[colon] != ':') continue;
+        std::string_view key = line.substr(0, k);
+        std::string_view value = trimView(line.substr(colon + 1));
+        if (value.empty()) {
+            uint32_t id = out.sectionId(key);
+            if (id == UINT32_MAX) {
+                id = static_cast<uint32_t>(out.sections.size());
+                out.sections.emplace_back(key);
+            }
+            section = id;
+        } else {
+            out.entries.push_back({section, std::string(key), std::string(unquote(value)),
+                                   static_cast<uint32_t>(out.pairs.size())});
+        }
+    }
+}
+
+inline std::string configCachePathFor(const std::string& path) { return path + ".cache"; }
+
+// 读取缓存；只检查结构是否完整，是否与配置一致由调用方比较 header
+inline bool readConfigCache(const std::string& cachePath, ConfigCacheHeader& header, ConfigFile& out) {
+    std::ifstream in(cachePath, std::ios::binary);
+    if (!in) return false;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(ConfigCacheHeader)) return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, kConfigCacheMagic, sizeof(kConfigCacheMagic)) != 0 ||
+        header.version != kConfigCacheVersion)
+        return false;
+    uint64_t tables = (uint64_t(header.sectionCount) * 2 + uint64_t(header.entryCount) * 6 +
+                       uint64_t(header.pairCount) * 3) * 4;
+    if (header.sectionCount == 0 || data.size() - sizeof(header) != tables + header.stringsSize) return false;
+
+    const char* p = data.data() + sizeof(header);
+    const char* strings = p + tables;
+    auto next = [&]() {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        p += 4;
+        return v;
+    };
+    bool ok = true;
+    auto str = [&](uint32_t offset, uint32_t length) {
+        if (uint64_t(offset) + length > header.stringsSize) {
+            ok = false;
+            return std::string();
+        }
+        return std::string(strings + offset, length);
+    };
+    out = ConfigFile();
+    out.sections.clear();
+    for (uint32_t i = 0; i < header.sectionCount; i++) {
+        uint32_t offset = next(), length = next();
+        out.sections.push_back(str(offset, length));
+    }
+    out.entries.reserve(header.entryCount);
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        ConfigEntry e;
+        e.section = next();
+        uint32_t keyOffset = next(), keyLength = next(), valueOffset = next(), valueLength = next();
+        e.key = str(keyOffset, keyLength);
+        e.value = str(valueOffset, valueLength);
+        e.pairsBefore = next();
+        if (e.section >= header.sectionCount) ok = false;
+        out.entries.push_back(std::move(e));
+    }
+    out.pairs.resize(header.pairCount);
+    for (auto& pair : out.pairs) {
+        pair.first = static_cast<int32_t>(next());
+        pair.second = static_cast<int32_t>(next());
+        pair.section = next();
+        if (pair.section >= header.sectionCount) ok = false;
+    }
+    return ok;
+}
+
+// 写入临时文件后替换；写入失败只影响下次启动的速度
+inline bool writeConfigCache(const std::string& cachePath, uint64_t size, uint64_t hash,
+                             const ConfigFile& config) {
+    std::string tables, strings;
+    auto put = [&](uint32_t v) { tables.append(reinterpret_cast<const char*>(&v), 4); };
+    auto putString = [&](const std::string& s) {
+        put(static_cast<uint32_t>(strings.size()));
+        put(static_cast<uint32_t>(s.size()));
+        strings += s;
+    };
+    for (const auto& s : config.sections) putString(s);
+    for (const auto& e : config.entries) {
+        put(e.section);
+        putString(e.key);
+        putString(e.value);
+        put(e.pairsBefore);
+    }
+    for (const auto& pair : config.pairs) {
+        put(static_cast<uint32_t>(pair.first));
+        put(static_cast<uint32_t>(pair.second));
+        put(pair.section);
+    }
+
+    ConfigCacheHeader header{};
+    std::memcpy(header.magic, kConfigCacheMagic, sizeof(kConfigCacheMagic));
+    header.version = kConfigCacheVersion;
+    header.sectionCount = static_cast<uint32_t>(config.sections.size());
+    header.entryCount = static_cast<uint32_t>(config.entries.size());
+    header.pairCount = static_cast<uint32_t>(config.pairs.size());
+    header.stringsSize = strings.size();
+    header.size = size;
+    header.hash = hash;
+
+    std::string tmpPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(tables.data(), tables.size());
+        out.write(strings.data(), strings.size());
+        if (!out) {
+            out.close();
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    return std::rename(tmpPath.c_str(), cachePath.c_str()) == 0;
+}
+
+// 读取配置，文件无法打开时返回 false
+inline bool loadConfigFile(const std::string& path, ConfigFile& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    uint64_t hash = configHash(text.data(), text.size());
+    std::string cachePath = configCachePathFor(path);
+    ConfigCacheHeader header{};
+    ConfigFile cached;
+    if (readConfigCache(cachePath, header, cached) && header.size == text.size() && header.hash == hash) {
+        out = std::move(cached);
+        return true;
+    }
+    parseConfigText(text, out);
+    writeConfigCache(cachePath, text.size(), hash, out);
+    return true;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// 补丁计划：先在内存中记录所有字节修改，读取时叠加已记录的修改，
+// 因此按原顺序逐对校验、交换的结果与每对都立即写盘完全相同；
+// 计划完成后每个文件只打开、写入一次，I/O 次数与涉及的文件数成正比，而不是与交换对数成正比。
+class PatchPlan {
+public:
+    PatchPlan() = default;
+    PatchPlan(const PatchPlan&) = delete;
+    PatchPlan& operator=(const PatchPlan&) = delete;
+
+    ~PatchPlan() {
+        for (auto& [path, f] : files_)
+            if (f.fd >= 0) ::close(f.fd);
+    }
+
+    // 读取 file 在 pos 处的 n 个字节（包含已计划的修改）。越界或无法读取时返回 false
+    bool read(const std::string& file, uint64_t pos, unsigned char* out, size_t n) {
+        FileState& f = state(file);
+        if (f.fd < 0 || pos + n > f.size) return false;
+        ssize_t got = ::pread(f.fd, out, n, static_cast<off_t>(pos));
+        if (got != static_cast<ssize_t>(n)) return false;
+        auto it = f.bytes.lower_bound(pos);
+        for (; it != f.bytes.end() && it->first < pos + n; ++it)
+            out[it->first - pos] = it->second.value;
+        return true;
+    }
+
+    bool matches(const std::string& file, uint64_t pos, const unsigned char* expected, size_t n) {
+        unsigned char small[16];
+        std::vector<unsigned char> large;
+        unsigned char* current = small;
+        if (n > sizeof(small)) {
+            large.resize(n);
+            current = large.data();
+        }
+        return read(file, pos, current, n) && std::equal(current, current + n, expected);
+    }
+
+    bool matches(const std::string& file, uint64_t pos, const std::vector<unsigned char>& expected) {
+        return matches(file, pos, expected.data(), expected.size());
+    }
+
+    // 记录修改，同时保存磁盘上的原始字节，供原地写入前校验
+    bool write(const std::string& file, uint64_t pos, const unsigned char* value, size_t n) {
+        FileState& f = state(file);
+        std::vector<unsigned char> original(n);
+        if (f.fd < 0 || pos + n > f.size ||
+            ::pread(f.fd, original.data(), n, static_cast<off_t>(pos)) != static_cast<ssize_t>(n))
+            return false;
+        for (size_t i = 0; i < n; i++) {
+            auto [it, inserted] = f.bytes.try_emplace(pos + i, ByteEdit{original[i], value[i]});
+            if (!inserted) it->second.value = value[i];
+        }
+        return true;
+    }
+
+    bool write(const std::string& file, uint64_t pos, const std::vector<unsigned char>& value) {
+        return write(file, pos, value.data(), value.size());
+    }
+
+    // 有修改的文件数量
+    size_t pendingFiles() const {
+        size_t n = 0;
+        for (const auto& [path, f] : files_)
+            if (!f.bytes.empty()) n++;
+        return n;
+    }
+
+    // 原地写入：把修改合并成连续区间，先校验每个区间在磁盘上仍是计划时读到的原始字节，
+    // 全部一致后再用 pwrite 只写这些区间。返回失败（被外部改动或无法写入）的文件。
+    // target 不为空时改写的是 target(文件) 返回的副本（如暂存目录中的文件），计划仍按源文件读取。
+    std::vector<std::string> commitInPlace(const std::function<std::string(const std::string&)>& target = nullptr) {
+        std::vector<std::string> failed;
+        for (auto& [path, f] : files_) {
+            if (f.bytes.empty()) continue;
+            std::vector<std::pair<uint64_t, std::vector<unsigned char>>> runs;
+            std::vector<std::vector<unsigned char>> originals;
+            for (const auto& [pos, edit] : f.bytes) {
+                if (runs.empty() || runs.back().first + runs.back().second.size() != pos) {
+                    runs.emplace_back(pos, std::vector<unsigned char>());
+                    originals.emplace_back();
+                }
+                runs.back().second.push_back(edit.value);
+                originals.back().push_back(edit.original);
+            }
+            std::string out = target ? target(path) : path;
+            int fd = out.empty() ? -1 : ::open(out.c_str(), O_RDWR | O_CLOEXEC);
+            bool ok = fd >= 0;
+            for (size_t i = 0; ok && i < runs.size(); i++) {
+                std::vector<unsigned char> current(originals[i].size());
+                ok = ::pread(fd, current.data(), current.size(), static_cast<off_t>(runs[i].first)) ==
+                         static_cast<ssize_t>(current.size()) &&
+                     current == originals[i];
+            }
+            for (size_t i = 0; ok && i < runs.size(); i++) {
+                const auto& [pos, bytes] = runs[i];
+                ok = ::pwrite(fd, bytes.data(), bytes.size(), static_cast<off_t>(pos)) ==
+                     static_cast<ssize_t>(bytes.size());
+            }
+            if (fd >= 0) ::close(fd);
+            if (!ok) failed.push_back(path);
+            f.bytes.clear();
+        }
+        return failed;
+    }
+
+private:
+    struct ByteEdit {
+        unsigned char original;
+        unsigned char value;
+    };
+
+    struct FileState {
+        int fd = -1;
+        uint64_t size = 0;
+        std::map<uint64_t, ByteEdit> bytes;
+    };
+
+    FileState& state(const std::string& file) {
+        auto [it, inserted] = files_.try_emplace(file);
+        FileState& f = it->second;
+        if (inserted) {
+            f.fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (f.fd >= 0 && ::fstat(f.fd, &st) == 0) f.size = static_cast<uint64_t>(st.st_size);
+        }
+        return f;
+    }
+
+    std::map<std::string, FileState> files_;
+};
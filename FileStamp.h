@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "MappedFile.h"
+
+// 判断文件是否变化：大小和修改时间（纳秒），以及可选的内容哈希。
+// 索引、目录表、命中记录和 fast、AutoMarker 的进程内缓存共用。
+
+struct FileStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+};
+
+inline bool statFile(const std::string& path, FileStamp& stamp) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) return false;
+    stamp.size = static_cast<uint64_t>(st.st_size);
+    stamp.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+// 内容哈希：文件大小 + 全部内容，按 8 字节一组混合。修改时间变了但大小没变（如重新解包）时，
+// 用它确认内容确实没变再沿用上次的记录；只比较首尾会漏掉中间改写的代码。0 表示没有哈希（读取失败）
+inline uint64_t contentHash(const unsigned char* data, size_t size) {
+    uint64_t h = 1469598103934665603ull ^ size;
+    auto mix = [&](uint64_t word) {
+        h = (h ^ word) * 1099511628211ull;
+        h ^= h >> 32;
+    };
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        mix(word);
+    }
+    for (; i < size; i++) mix(data[i]);
+    return h ? h : 1;
+}
+
+inline uint64_t fileContentHash(const std::string& path) {
+    uint64_t h = 0;
+    withFileData(path, [&](const unsigned char* data, size_t size) { h = contentHash(data, size); });
+    return h;
+}
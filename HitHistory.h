@@ -0,0 +1,136 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+
+#include "FileStamp.h"
+
+// 命中记录：保存每个文件在以往运行中命中过几次，以及最近一次检查时的大小、修改时间和是否命中。
+// 再次运行时先扫描命中过的文件，目标通常在最前面几个文件里就全部找到，可以提前结束；
+// 查找内容（key）相同且文件没有变化时，上次没有命中的文件可以直接跳过。
+//
+// 文本格式：第一行 "GFPHITS 1 <key>"，之后每行 "<命中次数> <大小> <修改时间> <上次是否命中> <路径>"。
+
+// 记录文件默认放在目录旁边：解包数据/dat -> 解包数据/dat.hits
+inline std::string hitHistoryPathFor(const std::string& directory) {
+    std::string dir = directory;
+    while (dir.size() > 1 && (dir.back() == '/' || dir.back() == '\\')) dir.pop_back();
+    return dir + ".hits";
+}
+
+class HitHistory {
+public:
+    // 读取记录。key 与上次不同时只沿用命中次数（用于排序），不再认为上次的未命中结果有效
+    bool load(const std::string& path, const std::string& key) {
+        std::ifstream in(path);
+        std::string line;
+        if (!in || !std::getline(in, line)) return false;
+        std::istringstream header(line);
+        std::string magic, saved_key;
+        int version = 0;
+        header >> magic >> version;
+        std::getline(header >> std::ws, saved_key);
+        if (magic != "GFPHITS" || version != 1) return false;
+        bool same_key = saved_key == key;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            Entry e;
+            int last_hit = 0;
+            std::string file;
+            if (!(fields >> e.hits >> e.stamp.size >> e.stamp.mtime >> last_hit)) continue;
+            std::getline(fields >> std::ws, file);
+            if (file.empty()) continue;
+            e.last_hit = last_hit != 0;
+            e.checked = same_key;
+            entries_[file] = e;
+        }
+        return true;
+    }
+
+    // 命中次数多的文件排在前面，其余保持原来的顺序
+    void order(std::vector<std::string>& files) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::stable_sort(files.begin(), files.end(), [&](const std::string& a, const std::string& b) {
+            return hitsLocked(a) > hitsLocked(b);
+        });
+    }
+
+    // hits / knownMiss / record 都加锁，可以在工作线程中与 record 同时调用
+    uint32_t hits(const std::string& file) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hitsLocked(file);
+    }
+
+    // 同一 key 下上次检查未命中，且文件大小和修改时间都没有变化
+    bool knownMiss(const std::string& file) const {
+        FileStamp saved;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(file);
+            if (it == entries_.end() || !it->second.checked || it->second.last_hit) return false;
+            saved = it->second.stamp;
+        }
+        FileStamp stamp;
+        return statFile(file, stamp) && stamp.size == saved.size && stamp.mtime == saved.mtime;
+    }
+
+    // 记录本次对文件的检查结果（线程安全）
+    void record(const std::string& file, bool hit) {
+        FileStamp stamp;
+        bool ok = statFile(file, stamp);
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry& e = entries_[file];
+        e.stamp = stamp;
+        e.last_hit = hit;
+        e.checked = ok;
+        if (hit) e.hits++;
+    }
+
+    // 写入临时文件后替换，只保留 files 中仍然存在的文件
+    bool save(const std::string& path, const std::string& key, const std::vector<std::string>& files) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::trunc);
+            if (!out) return false;
+            out << "GFPHITS 1 " << key << "\n";
+            for (const auto& file : files) {
+                auto it = entries_.find(file);
+                if (it == entries_.end()) continue;
+                const Entry& e = it->second;
+                // 本次没有检查过的文件不保留未命中结果
+                out << e.hits << ' ' << (e.checked ? e.stamp.size : 0) << ' ' << (e.checked ? e.stamp.mtime : -1)
+                    << ' ' << (e.last_hit ? 1 : 0) << ' ' << file << "\n";
+            }
+            if (!out) {
+                out.close();
+                std::remove(tmp_path.c_str());
+                return false;
+            }
+        }
+        return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    struct Entry {
+        uint32_t hits = 0;
+        FileStamp stamp;
+        bool last_hit = false;
+        bool checked = false;
+    };
+
+    uint32_t hitsLocked(const std::string& file) const {
+        auto it = entries_.find(file);
+        return it == entries_.end() ? 0 : it->second.hits;
+    }
+
+    std::unordered_map<std::string, Entry> entries_;
+    mutable std::mutex mutex_;
+};
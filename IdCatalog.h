@@ -0,0 +1,461 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "MappedFile.h"
+#include "IdMatcher.h"
+#include "WorkStealing.h"
+#include "FileStamp.h"
+#include "SkinLayout.h"
+
+// 解包数据的代码目录：美化工具能修改的每个代码、它的类别和位置。
+//   衣服块    fast 的对称块，按第一个目标值登记（cloth.yaml 中的代码）
+//   载具块    fast 的 ×100 块，按 ×100 后的值登记（vehicle.yaml 中的代码）
+//   图标映射  伪实体工具能在某个文件取到 14 字节映射的代码
+// 位置与工具实际修改的一致：块取文件顺序中的最后一个，图标映射取第一个文件中的第一次出现。
+//
+// 图标映射登记文件中所有能取到映射的代码，不需要事先知道代码（见 collectIconRecords），
+// 因此任何代码的查询都只是一次哈希探测。
+//
+// 增量更新：文件大小和修改时间（或内容哈希）没变时沿用上次的记录，只扫描变化的文件；
+// 每个变化的文件只读取一次，块和图标映射在同一遍中查找。特征值变化时全部重建。
+//
+// 磁盘格式（小端，各段 8 字节对齐，mmap 后直接查询）：
+//   CatalogHeader
+//   CatalogFileEntry[fileCount]     文件表
+//   char[stringsSize]               路径字符串，之后是特征值（十六进制，冒号分隔）
+//   CatalogRecord[recordCount]      按文件分组的记录
+//   CatalogEntry[entryCount]        每个代码一项
+//   uint32_t[slotCount]             开放寻址哈希表：代码 -> entry 下标 + 1，0 为空
+
+enum CatalogKind : uint32_t {
+    kCatalogCloth = 0,
+    kCatalogVehicle = 1,
+    kCatalogIcon = 2,
+    kCatalogKinds = 3
+};
+
+constexpr uint32_t kCatalogVersion = 4;
+constexpr char kCatalogMagic[8] = {'G', 'F', 'P', 'C', 'A', 'T', 'L', 'G'};
+constexpr uint32_t kCatalogNone = 0xFFFFFFFF;
+
+struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t fileCount;
+    uint64_t recordCount;
+    uint64_t entryCount;
+    uint64_t slotCount;
+    uint64_t filesOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t markersOffset;  // 特征值字符串在 strings 中的位置
+    uint64_t markersLength;
+    uint64_t recordsOffset;
+    uint64_t entriesOffset;
+    uint64_t slotsOffset;
+};
+
+struct CatalogFileEntry {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint64_t recordBegin;
+    uint64_t recordCount;
+};
+
+struct CatalogRecord {
+    uint32_t value;
+    uint32_t kind;
+    uint64_t offset;
+};
+
+struct CatalogEntry {
+    uint32_t value;
+    uint32_t kinds;                  // 按类别的位：1 << CatalogKind
+    uint32_t record[kCatalogKinds];  // 各类别的位置记录，没有时为 kCatalogNone
+};
+
+// 目录默认放在目录旁边：解包数据/uexp -> 解包数据/uexp.catalog
+inline std::string catalogPathFor(const std::string& directory) {
+    std::string dir = directory;
+    while (dir.size() > 1 && (dir.back() == '/' || dir.back() == '\\')) dir.pop_back();
+    return dir + ".catalog";
+}
+
+struct CatalogMarkers {
+    std::vector<unsigned char> block_start;
+    std::vector<unsigned char> block_end;
+    std::vector<unsigned char> icon_start;
+    std::vector<unsigned char> icon_end;
+
+    // 保存在目录中，特征值变化时目录全部重建
+    std::string key() const {
+        static const char digits[] = "0123456789abcdef";
+        std::string k;
+        for (const auto* m : {&block_start, &block_end, &icon_start, &icon_end}) {
+            if (!k.empty()) k += ':';
+            for (unsigned char c : *m) {
+                k += digits[c >> 4];
+                k += digits[c & 15];
+            }
+        }
+        return k;
+    }
+};
+
+inline size_t catalogSlot(uint32_t value, uint64_t slotCount) {
+    // slotCount 为 2 的幂，取乘法哈希的高位
+    unsigned bits = 0;
+    while ((uint64_t(1) << bits) < slotCount) bits++;
+    if (bits == 0) return 0;
+    return static_cast<size_t>(uint32_t(value * 0x9E3779B1u) >> (32 - bits));
+}
+
+// 只读目录，整个文件 mmap，查询一个代码只需一次哈希探测
+class IdCatalog {
+public:
+    struct Location {
+        std::string_view file;
+        uint64_t offset;
+    };
+
+    bool open(const std::string& path) {
+        file_ = MappedFile(path, false);
+        header_ = nullptr;
+        if (!file_.data() || file_.size() < sizeof(CatalogHeader)) return false;
+        const auto* h = reinterpret_cast<const CatalogHeader*>(file_.data());
+        if (std::memcmp(h->magic, kCatalogMagic, sizeof(kCatalogMagic)) != 0 || h->version != kCatalogVersion)
+            return false;
+        auto fits = [&](uint64_t offset, uint64_t bytes) {
+            return offset <= file_.size() && bytes <= file_.size() - offset;
+        };
+        if (!fits(h->filesOffset, uint64_t(h->fileCount) * sizeof(CatalogFileEntry)) ||
+            !fits(h->stringsOffset, h->stringsSize) ||
+            h->markersOffset + h->markersLength > h->stringsSize ||
+            !fits(h->recordsOffset, h->recordCount * sizeof(CatalogRecord)) ||
+            !fits(h->entriesOffset, h->entryCount * sizeof(CatalogEntry)) ||
+            !fits(h->slotsOffset, h->slotCount * sizeof(uint32_t)) ||
+            h->slotCount == 0 || (h->slotCount & (h->slotCount - 1)) != 0 || h->entryCount >= h->slotCount)
+            return false;
+        header_ = h;
+        files_ = reinterpret_cast<const CatalogFileEntry*>(file_.data() + h->filesOffset);
+        strings_ = reinterpret_cast<const char*>(file_.data() + h->stringsOffset);
+        records_ = reinterpret_cast<const CatalogRecord*>(file_.data() + h->recordsOffset);
+        entries_ = reinterpret_cast<const CatalogEntry*>(file_.data() + h->entriesOffset);
+        slots_ = reinterpret_cast<const uint32_t*>(file_.data() + h->slotsOffset);
+        for (uint32_t i = 0; i < h->fileCount; i++) {
+            const CatalogFileEntry& e = files_[i];
+            if (uint64_t(e.pathOffset) + e.pathLength > h->stringsSize ||
+                e.recordBegin + e.recordCount > h->recordCount) {
+                header_ = nullptr;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool valid() const { return header_ != nullptr; }
+    uint32_t fileCount() const { return header_ ? header_->fileCount : 0; }
+    uint64_t entryCount() const { return header_ ? header_->entryCount : 0; }
+    const CatalogFileEntry& fileEntry(uint32_t file) const { return files_[file]; }
+    std::string_view filePath(uint32_t file) const {
+        return std::string_view(strings_ + files_[file].pathOffset, files_[file].pathLength);
+    }
+    std::string_view markersKey() const {
+        return header_ ? std::string_view(strings_ + header_->markersOffset, header_->markersLength)
+                       : std::string_view();
+    }
+    const CatalogRecord* fileRecords(uint32_t file) const { return records_ + files_[file].recordBegin; }
+
+    // 代码所属类别的位（1 << CatalogKind），不在目录中时为 0
+    uint32_t kinds(uint32_t value) const {
+        const CatalogEntry* e = lookup(value);
+        return e ? e->kinds : 0;
+    }
+
+    bool has(uint32_t value, CatalogKind kind) const { return (kinds(value) >> kind) & 1; }
+
+    std::optional<Location> location(uint32_t value, CatalogKind kind) const {
+        const CatalogEntry* e = lookup(value);
+        if (!e || e->record[kind] == kCatalogNone) return std::nullopt;
+        uint64_t record = e->record[kind];
+        // 记录按文件分组，二分查找所在文件
+        uint32_t lo = 0, hi = header_->fileCount;
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (files_[mid].recordBegin <= record) lo = mid; else hi = mid;
+        }
+        return Location{filePath(lo), records_[record].offset};
+    }
+
+private:
+    const CatalogEntry* lookup(uint32_t value) const {
+        if (!header_) return nullptr;
+        uint64_t mask = header_->slotCount - 1;
+        for (size_t h = catalogSlot(value, header_->slotCount);; h = (h + 1) & mask) {
+            uint32_t slot = slots_[h];
+            if (slot == 0 || slot > header_->entryCount) return nullptr;
+            if (entries_[slot - 1].value == value) return &entries_[slot - 1];
+        }
+    }
+
+    MappedFile file_;
+    const CatalogHeader* header_ = nullptr;
+    const CatalogFileEntry* files_ = nullptr;
+    const char* strings_ = nullptr;
+    const CatalogRecord* records_ = nullptr;
+    const CatalogEntry* entries_ = nullptr;
+    const uint32_t* slots_ = nullptr;
+};
+
+// 文件中的衣服块和载具块记录。与 fast 一样跳过超过 4GB 的文件
+inline void collectBlockRecords(const unsigned char* data, size_t size, const CatalogMarkers& markers,
+                                std::vector<CatalogRecord>& out) {
+    if (size > 0xFFFFFFFFull) return;
+    forEachBlock(data, size, markers.block_start, markers.block_end, [&](const BlockMatch& match) {
+        if (match.cloth_position != bytesearch::npos)
+            out.push_back({match.first_value, kCatalogCloth, match.first_position});
+        if (match.vehicle_position != bytesearch::npos)
+            out.push_back({match.vehicle_value, kCatalogVehicle, match.vehicle_position});
+    });
+}
+
+// 文件中所有能取到图标映射的代码。伪实体工具取代码在文件中的第一次出现，离它最近的起始、结束特征值
+// 相隔 kMappingLength 字节时就是映射（见 locateMapping）。所以只有落在某对这样的特征值“最近范围”内的位置
+// 才可能符合：先收集这些位置上的 4 字节值作为候选，再按工具的规则（第一次出现处）逐个确认
+inline void collectIconRecords(const unsigned char* data, size_t size, const CatalogMarkers& markers,
+                               std::vector<CatalogRecord>& out) {
+    if (size < 4 || size > 0xFFFFFFFFull || markers.icon_start.empty() || markers.icon_end.empty()) return;
+    const MarkerIndex index = buildMarkerIndex(data, size, markers.icon_start, markers.icon_end);
+    const auto& starts = index.starts;
+    const auto& ends = index.ends;
+    if (starts.empty() || ends.empty()) return;
+    const uint64_t gap = markers.icon_start.size() + kMappingLength;
+    // positions[k] 是离哪些位置最近：[lo, hi)。取得宽一些，最终由 locateMapping 确认
+    auto cell = [size](const std::vector<uint64_t>& positions, size_t k) {
+        uint64_t lo = k > 0 ? (positions[k - 1] + positions[k]) / 2 : 0;
+        uint64_t hi = k + 1 < positions.size() ? (positions[k] + positions[k + 1]) / 2 + 1 : size;
+        return std::make_pair(lo, hi);
+    };
+    std::vector<int32_t> candidates;
+    for (size_t k = 0; k < starts.size(); k++) {
+        // 结束特征值在起始特征值之后或之前 gap 字节，两种顺序 locateMapping 都视为映射
+        for (uint64_t partner : {starts[k] + gap, starts[k] >= gap ? starts[k] - gap : UINT64_MAX}) {
+            auto it = std::lower_bound(ends.begin(), ends.end(), partner);
+            if (it == ends.end() || *it != partner) continue;
+            auto [start_lo, start_hi] = cell(starts, k);
+            auto [end_lo, end_hi] = cell(ends, static_cast<size_t>(it - ends.begin()));
+            uint64_t lo = std::max(start_lo, end_lo);
+            uint64_t hi = std::min<uint64_t>(std::min(start_hi, end_hi), size - 3);
+            for (uint64_t p = lo; p < hi; p++) candidates.push_back(static_cast<int32_t>(loadLE32(data + p)));
+        }
+    }
+    if (candidates.empty()) return;
+    const IdMatcher matcher(candidates);
+    std::vector<size_t> first_hit(matcher.size(), bytesearch::npos);
+    size_t remaining = matcher.size();
+    matcher.scan(data, size, [&](size_t i, size_t pos) {
+        if (first_hit[i] != bytesearch::npos) return true;
+        first_hit[i] = pos;
+        return --remaining > 0;
+    });
+    for (size_t i = 0; i < matcher.size(); i++) {
+        if (first_hit[i] == bytesearch::npos) continue;
+        auto location = locateMapping(index, markers.icon_start.size(), first_hit[i]);
+        if (location.has_value() && location->second == kMappingLength)
+            out.push_back({static_cast<uint32_t>(matcher.id(i)), kCatalogIcon, first_hit[i]});
+    }
+}
+
+struct CatalogUpdateStats {
+    size_t reused = 0;
+    size_t scanned = 0;
+    size_t removed = 0;
+    bool written = false;
+};
+
+// 按 files 的顺序（与工具遍历目录的顺序相同）增量更新目录。
+// progress / progressBytes 累加已处理的文件数和字节数（沿用的文件也计入），
+// 扫描期间调用线程每 200 毫秒调用一次 onProgress（可以为空）
+inline CatalogUpdateStats updateIdCatalog(const std::string& catalogPath,
+                                          const std::vector<std::string>& files,
+                                          const CatalogMarkers& markers,
+                                          WorkStealingPool& pool,
+                                          std::atomic<size_t>* progress = nullptr,
+                                          std::atomic<uint64_t>* progressBytes = nullptr,
+                                          const std::function<void()>& onProgress = nullptr) {
+    CatalogUpdateStats stats;
+    const std::string markersKey = markers.key();
+    IdCatalog old;
+    if (old.open(catalogPath) && old.markersKey() != markersKey) old = IdCatalog();
+
+    std::unordered_map<std::string_view, uint32_t> oldIds;
+    for (uint32_t i = 0; i < old.fileCount(); i++) oldIds.emplace(old.filePath(i), i);
+
+    const size_t count = files.size();
+    std::vector<CatalogFileEntry> entries(count);
+    std::vector<int64_t> reuseFrom(count, -1);
+    std::vector<size_t> toScan;
+    std::vector<uint64_t> weights(count);
+    // 修改时间变了但内容没变的文件：沿用记录，但要写入新的修改时间，下次不必再算内容哈希
+    bool retouched = false;
+    size_t matched = 0;  // 仍在 files 中的旧文件，其余的算作已删除
+    for (size_t i = 0; i < count; i++) {
+        FileStamp stamp;
+        statFile(files[i], stamp);
+        entries[i].size = stamp.size;
+        entries[i].mtime = stamp.mtime;
+        weights[i] = stamp.size;
+        auto it = oldIds.find(files[i]);
+        if (it != oldIds.end()) {
+            matched++;
+            const CatalogFileEntry& e = old.fileEntry(it->second);
+            // 上次读取失败的文件（修改时间 -1、哈希 0）总是重新扫描
+            if (e.mtime >= 0 && e.size == stamp.size &&
+                (e.mtime == stamp.mtime || (e.hash != 0 && e.hash == fileContentHash(files[i])))) {
+                entries[i].hash = e.hash;
+                retouched = retouched || e.mtime != stamp.mtime;
+                reuseFrom[i] = it->second;
+                stats.reused++;
+                if (progress) (*progress)++;
+                if (progressBytes) (*progressBytes) += stamp.size;
+                continue;
+            }
+        }
+        toScan.push_back(i);
+    }
+    stats.removed = old.fileCount() - matched;
+    stats.scanned = toScan.size();
+
+    if (stats.scanned == 0 && stats.removed == 0 && !retouched && old.valid()) return stats;
+
+    // 未变化的文件沿用记录，变化的文件读取一次，同时查找块和图标映射
+    std::vector<std::vector<CatalogRecord>> blocks(count), icons(count);
+    for (size_t i = 0; i < count; i++) {
+        if (reuseFrom[i] < 0) continue;
+        uint32_t id = static_cast<uint32_t>(reuseFrom[i]);
+        const CatalogRecord* r = old.fileRecords(id);
+        for (uint64_t k = 0; k < old.fileEntry(id).recordCount; k++)
+            (r[k].kind == kCatalogIcon ? icons[i] : blocks[i]).push_back(r[k]);
+    }
+    if (!toScan.empty()) {
+        std::vector<uint64_t> scanWeights;
+        for (size_t i : toScan) scanWeights.push_back(weights[i]);
+        pool.run(scanWeights, [&](size_t, size_t task) {
+            size_t i = toScan[task];
+            entries[i].hash = 0;
+            bool ok = withFileData(files[i], [&](const unsigned char* data, size_t size) {
+                entries[i].hash = contentHash(data, size);
+                collectBlockRecords(data, size, markers, blocks[i]);
+                collectIconRecords(data, size, markers, icons[i]);
+            });
+            if (!ok) entries[i].mtime = -1;  // 读取失败，下次重新扫描
+            if (progress) (*progress)++;
+            if (progressBytes) (*progressBytes) += weights[i];
+        }, onProgress, std::chrono::milliseconds(200));
+    }
+
+    // 记录按文件顺序排列；块记录后出现的覆盖先出现的，图标映射保留第一个
+    std::vector<CatalogRecord> records;
+    std::string strings;
+    std::unordered_map<uint32_t, CatalogEntry> byValue;
+    std::vector<uint32_t> order;
+    for (size_t i = 0; i < count; i++) {
+        entries[i].pathOffset = static_cast<uint32_t>(strings.size());
+        entries[i].pathLength = static_cast<uint32_t>(files[i].size());
+        strings += files[i];
+        entries[i].recordBegin = records.size();
+        for (const auto* list : {&blocks[i], &icons[i]}) {
+            for (const auto& r : *list) {
+                auto [it, inserted] = byValue.try_emplace(r.value);
+                CatalogEntry& e = it->second;
+                if (inserted) {
+                    e.value = r.value;
+                    e.kinds = 0;
+                    std::fill(std::begin(e.record), std::end(e.record), kCatalogNone);
+                    order.push_back(r.value);
+                }
+                if (r.kind != kCatalogIcon || e.record[r.kind] == kCatalogNone)
+                    e.record[r.kind] = static_cast<uint32_t>(records.size());
+                e.kinds |= 1u << r.kind;
+                records.push_back(r);
+            }
+        }
+        entries[i].recordCount = records.size() - entries[i].recordBegin;
+    }
+    if (records.size() >= kCatalogNone) return stats;
+    std::vector<CatalogEntry> catalogEntries;
+    catalogEntries.reserve(order.size());
+    for (uint32_t v : order) catalogEntries.push_back(byValue[v]);
+    uint64_t slotCount = 16;
+    while (slotCount < catalogEntries.size() * 2) slotCount <<= 1;
+    std::vector<uint32_t> slots(slotCount, 0);
+    for (size_t k = 0; k < catalogEntries.size(); k++) {
+        size_t h = catalogSlot(catalogEntries[k].value, slotCount);
+        while (slots[h] != 0) h = (h + 1) & (slotCount - 1);
+        slots[h] = static_cast<uint32_t>(k + 1);
+    }
+
+    auto align8 = [](uint64_t n) { return (n + 7) & ~uint64_t(7); };
+    CatalogHeader header{};
+    std::memcpy(header.magic, kCatalogMagic, sizeof(kCatalogMagic));
+    header.version = kCatalogVersion;
+    header.fileCount = static_cast<uint32_t>(count);
+    header.recordCount = records.size();
+    header.entryCount = catalogEntries.size();
+    header.slotCount = slotCount;
+    header.markersOffset = strings.size();
+    header.markersLength = markersKey.size();
+    strings += markersKey;
+    header.filesOffset = align8(sizeof(CatalogHeader));
+    header.stringsOffset = header.filesOffset + count * sizeof(CatalogFileEntry);
+    header.stringsSize = strings.size();
+    header.recordsOffset = align8(header.stringsOffset + strings.size());
+    header.entriesOffset = header.recordsOffset + records.size() * sizeof(CatalogRecord);
+    header.slotsOffset = align8(header.entriesOffset + catalogEntries.size() * sizeof(CatalogEntry));
+
+    std::string tmpPath = catalogPath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) return stats;
+        auto padTo = [&](uint64_t offset) {
+            static const char zeros[8] = {};
+            uint64_t at = static_cast<uint64_t>(out.tellp());
+            if (offset > at) out.write(zeros, offset - at);
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        padTo(header.filesOffset);
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(CatalogFileEntry));
+        out.write(strings.data(), strings.size());
+        padTo(header.recordsOffset);
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(CatalogRecord));
+        out.write(reinterpret_cast<const char*>(catalogEntries.data()),
+                  catalogEntries.size() * sizeof(CatalogEntry));
+        padTo(header.slotsOffset);
+        out.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(uint32_t));
+        if (!out) {
+            out.close();
+            std::remove(tmpPath.c_str());
+            return stats;
+        }
+    }
+    stats.written = std::rename(tmpPath.c_str(), catalogPath.c_str()) == 0;
+    return stats;
+}
@@ -0,0 +1,399 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <queue>
+#include <fstream>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "MappedFile.h"
+#include "WorkStealing.h"
+#include "FileStamp.h"
+#include "SkinLayout.h"
+
+// 解包数据的代码倒排索引：代码 -> (文件, 偏移)。
+// 只收录由特征值定位的代码位置（见 SkinLayout.h），不是文件中的每个 4 字节窗口：
+//   皮肤    cloth.yaml 的起止特征值之后跳过 kBlockTargetSkip 字节（fast 的块的第一个目标值）
+//   伪实体  伪实体配置.yaml 的起止特征值之后跳过 kEntityTargetSkip 字节
+// 同一文件中同一个代码的每个位置都记录，posting 个数就是这些位置的个数。
+// 因此索引只加速查找特征值定位的代码（美化工具实际修改的位置），代码在其他地方的出现仍需完整扫描；
+// 收录每个 4 字节窗口会让索引比解包数据本身大好几倍，所以不这样做。Search 只在 --index 模式下使用索引。
+// 特征值保存在索引中，变化时全部重建。
+//
+// 磁盘格式（小端，各段 8 字节对齐，可以直接 mmap 使用）：
+//   IndexHeader
+//   IndexFileEntry[fileCount]       文件表：大小、修改时间、内容哈希、路径
+//   char[stringsSize]               路径字符串，之后是特征值（十六进制，冒号分隔）
+//   uint64_t[postingCount]          (文件号 << 40) | 偏移，按 (代码, 文件号, 偏移) 排序
+//   uint32_t[valueCount]            已排序的代码
+//   uint64_t[valueCount + 1]        每个代码在 postings 中的起始下标
+// 建立时 posting 按代码顺序直接写入文件，代码表放在最后。
+
+constexpr uint32_t kIndexVersion = 3;
+constexpr char kIndexMagic[8] = {'G', 'F', 'P', 'I', 'D', 'X', '\0', '\0'};
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t fileCount;
+    uint64_t valueCount;
+    uint64_t postingCount;
+    uint64_t filesOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t markersOffset;  // 特征值字符串在 strings 中的位置
+    uint64_t markersLength;
+    uint64_t postingsOffset;
+    uint64_t valuesOffset;
+    uint64_t startsOffset;
+};
+
+struct IndexFileEntry {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+inline uint32_t postingFile(uint64_t posting) { return static_cast<uint32_t>(posting >> 40); }
+inline uint64_t postingOffset(uint64_t posting) { return posting & ((uint64_t(1) << 40) - 1); }
+inline uint64_t makePosting(uint32_t file, uint64_t offset) { return (uint64_t(file) << 40) | offset; }
+
+// 索引文件默认放在目录旁边：解包数据/dat -> 解包数据/dat.idx
+inline std::string indexPathFor(const std::string& directory) {
+    std::string dir = directory;
+    while (dir.size() > 1 && (dir.back() == '/' || dir.back() == '\\')) dir.pop_back();
+    return dir + ".idx";
+}
+
+struct IndexMarkers {
+    std::vector<unsigned char> skin_start;
+    std::vector<unsigned char> skin_end;
+    std::vector<unsigned char> entity_start;
+    std::vector<unsigned char> entity_end;
+
+    // 两种布局都缺少特征值时无法建立索引
+    bool empty() const {
+        return (skin_start.empty() || skin_end.empty()) && (entity_start.empty() || entity_end.empty());
+    }
+
+    std::string key() const {
+        static const char digits[] = "0123456789abcdef";
+        std::string k;
+        for (const auto* m : {&skin_start, &skin_end, &entity_start, &entity_end}) {
+            if (!k.empty()) k += ':';
+            for (unsigned char c : *m) {
+                k += digits[c >> 4];
+                k += digits[c & 15];
+            }
+        }
+        return k;
+    }
+};
+
+// 只读索引，整个文件 mmap，打开几乎没有开销
+class IdIndex {
+public:
+    bool open(const std::string& path) {
+        file_ = MappedFile(path, false);
+        header_ = nullptr;
+        if (!file_.data() || file_.size() < sizeof(IndexHeader)) return false;
+        const auto* h = reinterpret_cast<const IndexHeader*>(file_.data());
+        if (std::memcmp(h->magic, kIndexMagic, sizeof(kIndexMagic)) != 0 || h->version != kIndexVersion)
+            return false;
+        auto fits = [&](uint64_t offset, uint64_t bytes) {
+            return offset <= file_.size() && bytes <= file_.size() - offset;
+        };
+        if (!fits(h->filesOffset, uint64_t(h->fileCount) * sizeof(IndexFileEntry)) ||
+            !fits(h->stringsOffset, h->stringsSize) || h->markersOffset > h->stringsSize ||
+            h->markersLength > h->stringsSize - h->markersOffset ||
+            !fits(h->postingsOffset, h->postingCount * sizeof(uint64_t)) ||
+            !fits(h->valuesOffset, h->valueCount * sizeof(uint32_t)) ||
+            !fits(h->startsOffset, (h->valueCount + 1) * sizeof(uint64_t)))
+            return false;
+        header_ = h;
+        files_ = reinterpret_cast<const IndexFileEntry*>(file_.data() + h->filesOffset);
+        strings_ = reinterpret_cast<const char*>(file_.data() + h->stringsOffset);
+        postings_ = reinterpret_cast<const uint64_t*>(file_.data() + h->postingsOffset);
+        values_ = reinterpret_cast<const uint32_t*>(file_.data() + h->valuesOffset);
+        starts_ = reinterpret_cast<const uint64_t*>(file_.data() + h->startsOffset);
+        return true;
+    }
+
+    bool valid() const { return header_ != nullptr; }
+    size_t fileCount() const { return header_ ? header_->fileCount : 0; }
+    size_t valueCount() const { return header_ ? header_->valueCount : 0; }
+    size_t postingCount() const { return header_ ? header_->postingCount : 0; }
+    const IndexFileEntry& fileEntry(uint32_t file) const { return files_[file]; }
+    std::string_view filePath(uint32_t file) const {
+        return std::string_view(strings_ + files_[file].pathOffset, files_[file].pathLength);
+    }
+    std::string_view markersKey() const {
+        return header_ ? std::string_view(strings_ + header_->markersOffset, header_->markersLength)
+                       : std::string_view();
+    }
+    uint32_t value(size_t i) const { return values_[i]; }
+    std::pair<const uint64_t*, const uint64_t*> postingsAt(size_t i) const {
+        return {postings_ + starts_[i], postings_ + starts_[i + 1]};
+    }
+
+    // 返回某个代码的全部 posting，找不到时返回空区间
+    std::pair<const uint64_t*, const uint64_t*> lookup(uint32_t value) const {
+        if (!header_) return {nullptr, nullptr};
+        const uint32_t* end = values_ + header_->valueCount;
+        const uint32_t* it = std::lower_bound(values_, end, value);
+        if (it == end || *it != value) return {nullptr, nullptr};
+        return postingsAt(static_cast<size_t>(it - values_));
+    }
+
+private:
+    MappedFile file_;
+    const IndexHeader* header_ = nullptr;
+    const IndexFileEntry* files_ = nullptr;
+    const char* strings_ = nullptr;
+    const uint64_t* postings_ = nullptr;
+    const uint32_t* values_ = nullptr;
+    const uint64_t* starts_ = nullptr;
+};
+
+struct IndexUpdateStats {
+    size_t reused = 0;
+    size_t scanned = 0;
+    size_t removed = 0;
+    bool written = false;
+};
+
+// 建立索引时暂存在磁盘上的一条记录
+struct IndexSpillRecord {
+    uint32_t value;
+    uint32_t reserved;
+    uint64_t offset;
+};
+
+// 文件中由特征值定位的全部代码位置，按 (代码, 偏移) 排序。与 fast 一样跳过超过 4GB 的文件
+inline bool collectFileValues(const std::string& path, const IndexMarkers& markers,
+                              std::vector<IndexSpillRecord>& out, uint64_t& hash) {
+    out.clear();
+    hash = 0;
+    bool ok = withFileData(path, [&](const unsigned char* data, size_t size) {
+        hash = contentHash(data, size);
+        if (size > 0xFFFFFFFFull) return;
+        auto add = [&](uint32_t value, size_t pos) { out.push_back({value, 0, pos}); };
+        forEachMarkedValue(data, size, markers.skin_start, markers.skin_end, kBlockTargetSkip, add);
+        forEachMarkedValue(data, size, markers.entity_start, markers.entity_end, kEntityTargetSkip, add);
+    });
+    std::sort(out.begin(), out.end(), [](const IndexSpillRecord& a, const IndexSpillRecord& b) {
+        return a.value != b.value ? a.value < b.value : a.offset < b.offset;
+    });
+    return ok;
+}
+
+// 增量更新索引：大小与修改时间（或内容哈希）未变的文件直接沿用旧索引中的 posting，
+// 只重新扫描新增或变化的文件；扫描使用工作窃取线程池并行完成。
+// 每个文件扫描完就把记录作为一段有序的 run 追加到临时文件（indexPath.spill），最后按代码多路归并，
+// posting 直接写入新索引，内存中只保留代码表和当前代码的 posting。写入临时文件后原子替换。
+// progress / progressBytes 累加已处理的文件数和字节数（沿用的文件也计入），
+// 扫描期间调用线程每 200 毫秒调用一次 onProgress（可以为空），用来显示这两个计数。
+inline IndexUpdateStats updateIdIndex(const std::string& indexPath,
+                                      const std::vector<std::string>& files,
+                                      const IndexMarkers& markers,
+                                      WorkStealingPool& pool,
+                                      std::atomic<size_t>* progress = nullptr,
+                                      std::atomic<uint64_t>* progressBytes = nullptr,
+                                      const std::function<void()>& onProgress = nullptr) {
+    IndexUpdateStats stats;
+    const std::string markersKey = markers.key();
+    IdIndex old;
+    if (old.open(indexPath) && old.markersKey() != markersKey) old = IdIndex();
+
+    std::unordered_map<std::string_view, uint32_t> oldIds;
+    for (uint32_t i = 0; i < old.fileCount(); i++) oldIds.emplace(old.filePath(i), i);
+
+    const size_t count = files.size();
+    std::vector<IndexFileEntry> entries(count);
+    std::vector<int64_t> reuseFrom(count, -1);
+    std::vector<size_t> toScan;
+    std::vector<uint64_t> scanWeights;
+    // 修改时间变了但内容没变的文件：沿用记录，但要写入新的修改时间，下次不必再算内容哈希
+    bool retouched = false;
+    size_t matched = 0;  // 仍在 files 中的旧文件，其余的算作已删除
+    for (size_t i = 0; i < count; i++) {
+        FileStamp stamp;
+        statFile(files[i], stamp);
+        entries[i].size = stamp.size;
+        entries[i].mtime = stamp.mtime;
+        auto it = oldIds.find(files[i]);
+        if (it != oldIds.end()) {
+            matched++;
+            const IndexFileEntry& e = old.fileEntry(it->second);
+            // 上次读取失败的文件（修改时间 -1、哈希 0）总是重新扫描
+            bool same = e.mtime >= 0 && e.size == stamp.size &&
+                        (e.mtime == stamp.mtime || (e.hash != 0 && e.hash == fileContentHash(files[i])));
+            if (same) {
+                entries[i].hash = e.hash;
+                retouched = retouched || e.mtime != stamp.mtime;
+                reuseFrom[i] = it->second;
+                stats.reused++;
+                if (progress) (*progress)++;
+                if (progressBytes) (*progressBytes) += stamp.size;
+                continue;
+            }
+        }
+        toScan.push_back(i);
+        scanWeights.push_back(stamp.size);
+    }
+    stats.removed = old.fileCount() - matched;
+    stats.scanned = toScan.size();
+    if (stats.scanned == 0 && stats.removed == 0 && !retouched && old.valid()) return stats;
+
+    const std::string spillPath = indexPath + ".spill";
+    std::vector<uint64_t> runBegin(count, 0), runLength(count, 0);
+    {
+        std::ofstream spill(spillPath, std::ios::binary | std::ios::trunc);
+        if (!spill) return stats;
+        std::mutex spillMutex;
+        uint64_t spilled = 0;
+        std::vector<std::vector<IndexSpillRecord>> buffers(pool.size());
+        if (!toScan.empty()) {
+            pool.run(scanWeights, [&](size_t worker, size_t task) {
+                size_t i = toScan[task];
+                std::vector<IndexSpillRecord>& records = buffers[worker];
+                if (!collectFileValues(files[i], markers, records, entries[i].hash))
+                    entries[i].mtime = -1;  // 读取失败，下次重新扫描
+                {
+                    std::lock_guard<std::mutex> lock(spillMutex);
+                    runBegin[i] = spilled;
+                    runLength[i] = records.size();
+                    spill.write(reinterpret_cast<const char*>(records.data()),
+                                records.size() * sizeof(IndexSpillRecord));
+                    spilled += records.size();
+                }
+                if (progress) (*progress)++;
+                if (progressBytes) (*progressBytes) += entries[i].size;
+            }, onProgress, std::chrono::milliseconds(200));
+        }
+        if (!spill) {
+            spill.close();
+            std::remove(spillPath.c_str());
+            return stats;
+        }
+    }
+    MappedFile spillFile(spillPath);
+    const auto* spilled = reinterpret_cast<const IndexSpillRecord*>(spillFile.data());
+
+    std::vector<int64_t> newIdOf(old.fileCount(), -1);
+    for (size_t i = 0; i < count; i++)
+        if (reuseFrom[i] >= 0) newIdOf[reuseFrom[i]] = static_cast<int64_t>(i);
+
+    std::string strings;
+    for (size_t i = 0; i < count; i++) {
+        entries[i].pathOffset = static_cast<uint32_t>(strings.size());
+        entries[i].pathLength = static_cast<uint32_t>(files[i].size());
+        strings += files[i];
+    }
+    auto align8 = [](uint64_t n) { return (n + 7) & ~uint64_t(7); };
+
+    IndexHeader header{};
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexVersion;
+    header.fileCount = static_cast<uint32_t>(count);
+    header.markersOffset = strings.size();
+    header.markersLength = markersKey.size();
+    strings += markersKey;
+    header.filesOffset = align8(sizeof(IndexHeader));
+    header.stringsOffset = header.filesOffset + count * sizeof(IndexFileEntry);
+    header.stringsSize = strings.size();
+    header.postingsOffset = align8(header.stringsOffset + strings.size());
+
+    std::string tmpPath = indexPath + ".tmp";
+    bool ok;
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            spillFile = MappedFile();
+            std::remove(spillPath.c_str());
+            return stats;
+        }
+        auto padTo = [&](uint64_t offset) {
+            static const char zeros[8] = {};
+            uint64_t at = static_cast<uint64_t>(out.tellp());
+            if (offset > at) out.write(zeros, offset - at);
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        padTo(header.filesOffset);
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(IndexFileEntry));
+        out.write(strings.data(), strings.size());
+        padTo(header.postingsOffset);
+
+        // 按代码归并旧索引和各文件的 run：每个代码收齐后按 (文件号, 偏移) 排序写出
+        std::vector<uint32_t> values;
+        std::vector<uint64_t> starts;
+        uint64_t postingCount = 0;
+        using Cursor = std::pair<uint32_t, uint32_t>;  // (代码, 文件号)
+        std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> heap;
+        std::vector<uint64_t> pos(count, 0);
+        for (size_t i = 0; i < count; i++)
+            if (runLength[i] > 0) heap.emplace(spilled[runBegin[i]].value, static_cast<uint32_t>(i));
+        size_t oldValue = 0;
+        std::vector<uint64_t> group;
+        while (!heap.empty() || oldValue < old.valueCount()) {
+            uint32_t value = heap.empty() ? old.value(oldValue) : heap.top().first;
+            if (oldValue < old.valueCount() && old.value(oldValue) < value) value = old.value(oldValue);
+            group.clear();
+            if (oldValue < old.valueCount() && old.value(oldValue) == value) {
+                auto [begin, end] = old.postingsAt(oldValue++);
+                for (const uint64_t* p = begin; p != end; ++p) {
+                    int64_t id = newIdOf[postingFile(*p)];
+                    if (id >= 0) group.push_back(makePosting(static_cast<uint32_t>(id), postingOffset(*p)));
+                }
+            }
+            while (!heap.empty() && heap.top().first == value) {
+                uint32_t file = heap.top().second;
+                heap.pop();
+                const IndexSpillRecord* run = spilled + runBegin[file];
+                uint64_t& p = pos[file];
+                while (p < runLength[file] && run[p].value == value) {
+                    group.push_back(makePosting(file, run[p].offset));
+                    p++;
+                }
+                if (p < runLength[file]) heap.emplace(run[p].value, file);
+            }
+            if (group.empty()) continue;
+            std::sort(group.begin(), group.end());
+            values.push_back(value);
+            starts.push_back(postingCount);
+            out.write(reinterpret_cast<const char*>(group.data()), group.size() * sizeof(uint64_t));
+            postingCount += group.size();
+        }
+        starts.push_back(postingCount);
+
+        header.valueCount = values.size();
+        header.postingCount = postingCount;
+        header.valuesOffset = header.postingsOffset + postingCount * sizeof(uint64_t);
+        header.startsOffset = align8(header.valuesOffset + values.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(uint32_t));
+        padTo(header.startsOffset);
+        out.write(reinterpret_cast<const char*>(starts.data()), starts.size() * sizeof(uint64_t));
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ok = static_cast<bool>(out);
+    }
+    spillFile = MappedFile();
+    std::remove(spillPath.c_str());
+    if (!ok) {
+        std::remove(tmpPath.c_str());
+        return stats;
+    }
+    stats.written = std::rename(tmpPath.c_str(), indexPath.c_str()) == 0;
+    return stats;
+}
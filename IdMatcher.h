@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// 一次扫描同时匹配大量 4 字节小端整数（皮肤代码等）。
+// 每个位置先用前两个字节查 64K 位的过滤表，绝大多数位置在这里就被排除；
+// 通过过滤的再查开放寻址哈希表，因此代价与代码数量基本无关。
+class IdMatcher {
+public:
+    IdMatcher() = default;
+
+    explicit IdMatcher(const std::vector<int32_t>& ids) {
+        for (int32_t id : ids) ids_.push_back(static_cast<uint32_t>(id));
+        std::sort(ids_.begin(), ids_.end());
+        ids_.erase(std::unique(ids_.begin(), ids_.end()), ids_.end());
+
+        size_t capacity = 16;
+        shift_ = 28;
+        while (capacity < ids_.size() * 2) {
+            capacity <<= 1;
+            shift_--;
+        }
+        mask_ = capacity - 1;
+        keys_.assign(capacity, 0);
+        slots_.assign(capacity, -1);
+        filter_.assign(65536 / 64, 0);
+        for (size_t i = 0; i < ids_.size(); i++) {
+            uint32_t v = ids_[i];
+            size_t h = hash(v);
+            while (slots_[h] >= 0) h = (h + 1) & mask_;
+            keys_[h] = v;
+            slots_[h] = static_cast<int32_t>(i);
+            filter_[(v & 0xFFFF) >> 6] |= uint64_t(1) << (v & 63);
+        }
+    }
+
+    size_t size() const { return ids_.size(); }
+    bool empty() const { return ids_.empty(); }
+    // 下标 -> 代码（下标按代码升序排列）
+    int32_t id(size_t index) const { return static_cast<int32_t>(ids_[index]); }
+
+    // 返回代码的下标，不存在时返回 -1
+    int find(uint32_t value) const {
+        if (ids_.empty() || !(filter_[(value & 0xFFFF) >> 6] & (uint64_t(1) << (value & 63))))
+            return -1;
+        return lookup(value);
+    }
+
+    // 扫描 [data, data + length) 中每个 4 字节窗口，命中时调用 onHit(下标, 位置)。
+    // onHit 返回 false 时提前结束。
+    template <class Fn>
+    void scan(const unsigned char* data, size_t length, Fn&& onHit) const {
+        if (ids_.empty() || length < 4) return;
+        const size_t last = length - 4;
+        for (size_t i = 0; i <= last; i++) {
+            uint16_t low;
+            std::memcpy(&low, data + i, 2);
+            if (!(filter_[low >> 6] & (uint64_t(1) << (low & 63)))) continue;
+            uint32_t v;
+            std::memcpy(&v, data + i, 4);
+            int index = lookup(v);
+            if (index >= 0 && !onHit(static_cast<size_t>(index), i)) return;
+        }
+    }
+
+private:
+    size_t hash(uint32_t v) const {
+        return static_cast<size_t>((v * 0x9E3779B1u) >> shift_);
+    }
+
+    int lookup(uint32_t value) const {
+        size_t h = hash(value);
+        while (slots_[h] >= 0) {
+            if (keys_[h] == value) return slots_[h];
+            h = (h + 1) & mask_;
+        }
+        return -1;
+    }
+
+    std::vector<uint32_t> ids_;
+    std::vector<uint32_t> keys_;
+    std::vector<int32_t> slots_;
+    std::vector<uint64_t> filter_;
+    size_t mask_ = 0;
+    unsigned shift_ = 28;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// 扫描窗口大小：mmap 模式下每处理完一个窗口就归还对应页面，
+// 分块读取模式下这就是缓冲区大小，因此峰值内存与文件大小无关。
+constexpr size_t kScanWindow = 8u << 20;
+
+enum class ScanMode {
+    Auto,   // 优先 mmap，失败时回退到分块读取
+    Mmap,
+    Stream
+};
+
+// 只读映射整个文件。映射失败时 data() 为 nullptr，调用方可改用分块读取。
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path, bool sequential = true) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) return;
+        struct stat st;
+        if (::fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode)) {
+            close();
+            return;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0) return;
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (p == MAP_FAILED) return;
+        data_ = static_cast<const unsigned char*>(p);
+        if (sequential) {
+            ::madvise(const_cast<unsigned char*>(data_), size_, MADV_SEQUENTIAL);
+            ::madvise(const_cast<unsigned char*>(data_), std::min(size_, kScanWindow), MADV_WILLNEED);
+        }
+    }
+
+    ~MappedFile() {
+        unmap();
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+        : fd_(std::exchange(other.fd_, -1)),
+          data_(std::exchange(other.data_, nullptr)),
+          size_(std::exchange(other.size_, 0)) {}
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            close();
+            fd_ = std::exchange(other.fd_, -1);
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    // 文件已成功打开（空文件也算）
+    bool opened() const { return fd_ >= 0; }
+    // 内容可直接访问：映射成功，或者文件为空
+    bool mapped() const { return data_ != nullptr || (fd_ >= 0 && size_ == 0); }
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+    int fd() const { return fd_; }
+
+    // 归还 [offset, offset + length) 对应的页面，用于顺序扫描时保持内存占用平稳
+    void release(size_t offset, size_t length) const {
+        if (!data_ || length == 0) return;
+        const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t begin = (offset + page - 1) / page * page;
+        size_t end = std::min(offset + length, size_) / page * page;
+        if (end > begin)
+            ::madvise(const_cast<unsigned char*>(data_) + begin, end - begin, MADV_DONTNEED);
+    }
+
+    // 提前预读 [offset, offset + length)
+    void prefetch(size_t offset, size_t length) const {
+        if (!data_ || offset >= size_) return;
+        const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t begin = offset / page * page;
+        size_t end = std::min(offset + length, size_);
+        ::madvise(const_cast<unsigned char*>(data_) + begin, end - begin, MADV_WILLNEED);
+    }
+
+private:
+    void unmap() {
+        if (data_) ::munmap(const_cast<unsigned char*>(data_), size_);
+        data_ = nullptr;
+    }
+    void close() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    int fd_ = -1;
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// 文件内容：优先 mmap，失败时整体读入
+template <class Fn>
+bool withFileData(const std::string& path, Fn&& fn) {
+    MappedFile mf(path);
+    if (!mf.opened()) return false;
+    if (mf.data() || mf.size() == 0) {
+        fn(mf.data(), mf.size());
+        return true;
+    }
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    fn(data.data(), data.size());
+    return true;
+}
+
+// 按窗口顺序扫描文件。相邻窗口之间保留 overlap 字节（一般取模式长度 - 1），
+// 跨窗口的匹配不会漏掉，也不会重复上报。
+// fn(const unsigned char* data, size_t length, uint64_t base_offset) 返回 false 时提前结束。
+// 返回值表示文件能否读取。
+template <class Fn>
+bool scanFileChunks(const std::string& path, size_t overlap, Fn&& fn,
+                    ScanMode mode = ScanMode::Auto, size_t window = kScanWindow) {
+    if (window <= overlap) window = overlap + kScanWindow;
+
+    if (mode != ScanMode::Stream) {
+        MappedFile mf(path);
+        if (!mf.opened()) return false;
+        if (mf.mapped()) {
+            const size_t size = mf.size();
+            size_t offset = 0;
+            while (offset < size) {
+                size_t length = std::min(window, size - offset);
+                size_t with_overlap = std::min(length + overlap, size - offset);
+                mf.prefetch(offset + length, window);
+                if (!fn(mf.data() + offset, with_overlap, static_cast<uint64_t>(offset)))
+                    break;
+                mf.release(offset, length);
+                offset += length;
+            }
+            return true;
+        }
+        if (mode == ScanMode::Mmap) return false;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+#ifdef POSIX_FADV_SEQUENTIAL
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    std::vector<unsigned char> buffer(window + overlap);
+    size_t carried = 0;
+    uint64_t base = 0;
+    bool ok = true;
+    while (true) {
+        ssize_t n = ::read(fd, buffer.data() + carried, buffer.size() - carried);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            ok = false;
+            break;
+        }
+        if (n == 0) break;
+        size_t filled = carried + static_cast<size_t>(n);
+        // 读不满说明可能还没到结尾，继续补满，减少回调次数；读出错时整个文件算作扫描失败
+        while (filled < buffer.size()) {
+            ssize_t more = ::read(fd, buffer.data() + filled, buffer.size() - filled);
+            if (more < 0 && errno == EINTR) continue;
+            if (more < 0) ok = false;
+            if (more <= 0) break;
+            filled += static_cast<size_t>(more);
+        }
+        if (!ok) break;
+        if (!fn(buffer.data(), filled, base)) break;
+        if (filled < buffer.size()) break;
+        size_t keep = std::min(overlap, filled);
+        std::copy(buffer.end() - keep, buffer.end(), buffer.begin());
+        base += filled - keep;
+        carried = keep;
+    }
+    ::close(fd);
+    return ok;
+}
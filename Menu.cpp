@@ -4,9 +4,16 @@
 #include <filesystem>
 #include <cstdlib>
 #include <sstream>
-#include <thread>
-#include <chrono>
 #include <fstream>
+#include <cstdio>
+#include <cerrno>
+#include <poll.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "Progress.h"
 
 namespace fs = std::filesystem;
 
@@ -32,13 +39,125 @@ void clearScreen() {
 }
 
 
-void show_loading() {
-    const std::string spinner = "|/-\\";
-    for (int i = 0; i < 30; ++i) {
-        std::cout << " [" << spinner[i % spinner.size()] << "]  " << "\r" << std::flush;
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+// 显示工具通过进度通道（见 Progress.h）汇报的进度，每次更新覆盖同一行
+class ProgressView {
+public:
+    void feed(const std::string &line) {
+        std::vector<std::string> fields;
+        std::istringstream in(line);
+        std::string field;
+        while (std::getline(in, field, '\t'))
+            fields.push_back(field);
+        if (fields.empty()) return;
+        if (fields[0] == "phase" && fields.size() >= 4) {
+            close_line();
+            phase_ = fields[1];
+            files_total_ = std::strtoull(fields[2].c_str(), nullptr, 10);
+            bytes_total_ = std::strtoull(fields[3].c_str(), nullptr, 10);
+            render(0, 0, -1);
+        } else if (fields[0] == "progress" && fields.size() >= 4) {
+            render(std::strtoull(fields[1].c_str(), nullptr, 10), std::strtoull(fields[2].c_str(), nullptr, 10),
+                   std::strtoll(fields[3].c_str(), nullptr, 10));
+        } else if (fields[0] == "end") {
+            close_line();
+        }
+    }
+
+    void close_line() {
+        if (!open_) return;
+        std::cout << std::endl;
+        open_ = false;
+    }
+
+private:
+    void render(unsigned long long files, unsigned long long bytes, long long eta_ms) {
+        char text[256];
+        int n = std::snprintf(text, sizeof(text), " [%s] %llu/%llu 个文件", phase_.c_str(), files, files_total_);
+        if (bytes_total_ > 0 && n > 0 && n < static_cast<int>(sizeof(text)))
+            n += std::snprintf(text + n, sizeof(text) - n, "  %.1f/%.1f MB", bytes / 1048576.0, bytes_total_ / 1048576.0);
+        if (eta_ms > 0 && n > 0 && n < static_cast<int>(sizeof(text)))
+            std::snprintf(text + n, sizeof(text) - n, "  剩余约 %lld 秒", (eta_ms + 999) / 1000);
+        std::cout << "\r\033[K" << CYAN << text << RESET << std::flush;
+        open_ = true;
+    }
+
+    std::string phase_;
+    unsigned long long files_total_ = 0;
+    unsigned long long bytes_total_ = 0;
+    bool open_ = false;
+};
+
+// 运行工具并实时显示它汇报的进度，工具退出后立即返回。
+// 与 std::system 一样，等待期间 Ctrl-C 只结束工具，不结束菜单
+int run_tool(const std::string &command) {
+    int channel[2];
+    if (::pipe2(channel, O_CLOEXEC) != 0)
+        return std::system(command.c_str());
+    struct sigaction ignore{}, old_int{}, old_quit{};
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    ::sigaction(SIGINT, &ignore, &old_int);
+    ::sigaction(SIGQUIT, &ignore, &old_quit);
+    std::cout.flush();
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        ::sigaction(SIGINT, &old_int, nullptr);
+        ::sigaction(SIGQUIT, &old_quit, nullptr);
+        int fd = ::dup(channel[1]);  // 去掉 CLOEXEC，留给工具
+        ::setenv(kProgressFdEnv, std::to_string(fd).c_str(), 1);
+        ::execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char *>(nullptr));
+        ::_exit(127);
+    }
+    ::close(channel[1]);
+    if (pid < 0) {
+        ::close(channel[0]);
+        ::sigaction(SIGINT, &old_int, nullptr);
+        ::sigaction(SIGQUIT, &old_quit, nullptr);
+        return std::system(command.c_str());
+    }
+
+    ProgressView view;
+    std::string pending;
+    char buffer[4096];
+    auto consume = [&](ssize_t n) {
+        pending.append(buffer, static_cast<size_t>(n));
+        size_t eol;
+        while ((eol = pending.find('\n')) != std::string::npos) {
+            view.feed(pending.substr(0, eol));
+            pending.erase(0, eol + 1);
+        }
+    };
+    int status = -1;
+    // 工具退出或管道关闭即结束；工具启动的后台进程持有管道时也不会一直等待
+    while (true) {
+        pollfd p{channel[0], POLLIN, 0};
+        if (::poll(&p, 1, 100) > 0) {
+            ssize_t n = ::read(channel[0], buffer, sizeof(buffer));
+            if (n > 0) {
+                consume(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+            }
+            break;
+        }
+        pid_t done = ::waitpid(pid, &status, WNOHANG);
+        if (done == pid || (done < 0 && errno != EINTR)) {
+            // 读完工具退出前写入的进度
+            ::fcntl(channel[0], F_SETFL, ::fcntl(channel[0], F_GETFL) | O_NONBLOCK);
+            ssize_t n;
+            while ((n = ::read(channel[0], buffer, sizeof(buffer))) > 0)
+                consume(n);
+            break;
+        }
     }
+    view.close_line();
+    ::close(channel[0]);
+    ::sigaction(SIGINT, &old_int, nullptr);
+    ::sigaction(SIGQUIT, &old_quit, nullptr);
     std::cout << "    完成!" << std::endl;
+    return status;
 }
 
 void show_main_menu() {
@@ -97,6 +216,24 @@ bool select_pak_file(const std::string &dir, std::string &selected_file) {
     }
 }
 
+// 有常驻服务的工具。fast 保留块表，AutoMarker 保留每个 dat 的查找结果，之后只重新扫描发生变化的文件
+const char *const kServedTools[] = {"./tools/fast", "./tools/AutoMarker"};
+
+// 在后台启动常驻服务；同一程序的服务已在运行时新进程会直接退出，旧版本的服务会被替换
+void start_servers() {
+    for (const char *tool : kServedTools) {
+        if (fs::exists(tool))
+            std::system((std::string(tool) + " --serve >/dev/null 2>&1 &").c_str());
+    }
+}
+
+void stop_servers() {
+    for (const char *tool : kServedTools) {
+        if (fs::exists(tool))
+            std::system((std::string(tool) + " --stop >/dev/null 2>&1").c_str());
+    }
+}
+
 int main() {
 
     std::string PAK_DIR = DEFAULT_PAK_DIR;
@@ -106,6 +243,8 @@ int main() {
         return 1;
     }
 
+    start_servers();
+
     while (true) {
         clearScreen();
         show_main_menu();
@@ -126,16 +265,13 @@ int main() {
                     std::cin >> sub_choice;
                     if (sub_choice == 1) {
                         std::cout << YELLOW << "开始自动美化衣服..." << RESET << std::endl;
-                        std::system("./tools/AutoSwitchSkin");
-                        show_loading();
+                        run_tool("./tools/AutoSwitchSkin");
                     } else if (sub_choice == 2) {
                         std::cout << YELLOW << "开始自动美化衣服..." << RESET << std::endl;
-                        std::system("./tools/fast");
-                        show_loading();
+                        run_tool("./tools/fast");
                     } else if (sub_choice == 3) {
                         std::cout << YELLOW << "开始自动美化衣服图标..." << RESET << std::endl;
-                        std::system("./tools/AutoSwitchSkinIcon");
-                        show_loading();
+                        run_tool("./tools/AutoSwitchSkinIcon");
                     } else if (sub_choice == 4) {
                         clearScreen();
                         break;
@@ -164,16 +300,14 @@ int main() {
                             std::cout << YELLOW << "正在解包 .dat 文件..." << RESET << std::endl;
                             // 调用外部命令：注意引号用法
                             std::string cmd = "qemu-i386 tools/quickbms tools/Extract.bms \"" + selected_file + "\" \"解包数据/dat\"";
-                            std::system(cmd.c_str());
-                            show_loading();
+                            run_tool(cmd);
                         }
                     } else if (unpack_choice == 2) {
                         std::string selected_file;
                         if (select_pak_file(PAK_DIR, selected_file)) {
                             std::cout << YELLOW << "正在解包 .uexp 文件..." << RESET << std::endl;
                             std::string cmd = "./tools/unpack -a \"" + selected_file + "\" \"解包数据/uexp\"";
-                            std::system(cmd.c_str());
-                            show_loading();
+                            run_tool(cmd);
                         }
                     } else if (unpack_choice == 3) {
                         clearScreen();
@@ -202,16 +336,14 @@ int main() {
                         if (select_pak_file(PAK_DIR, selected_file)) {
                             std::cout << YELLOW << "正在打包 .dat 文件..." << RESET << std::endl;
                             std::string cmd = "qemu-i386 tools/quickbms -w -r -r tools/Pack.bms \"" + selected_file + "\" \"打包/dat\"";
-                            std::system(cmd.c_str());
-                            show_loading();
+                            run_tool(cmd);
                         }
                     } else if (pack_choice == 2) {
                         std::string selected_file;
                         if (select_pak_file(PAK_DIR, selected_file)) {
                             std::cout << YELLOW << "正在打包 .uexp 文件..." << RESET << std::endl;
                             std::string cmd = "./tools/unpack -a -r \"" + selected_file + "\" \"打包/uexp\"";
-                            std::system(cmd.c_str());
-                            show_loading();
+                            run_tool(cmd);
                         }
                     } else if (pack_choice == 3) {
                         clearScreen();
@@ -228,15 +360,45 @@ int main() {
             case 4: {
                 clearScreen();
                 std::cout << WHITE << "自动搜索特征值..." << RESET << std::endl;
-                std::system("./tools/AutoMarker");
+                std::cout << YELLOW << "1) 自动搜索并更新配置中的特征值" << RESET << std::endl;
+                std::cout << YELLOW << "2) 按代码列出候选特征值（不修改配置）" << RESET << std::endl;
+                std::cout << BOLD << "请选择对应序号：" << RESET;
+                int marker_choice = 0;
+                std::cin >> marker_choice;
+                if (marker_choice == 2) {
+                    std::cout << BOLD << "请输入皮肤代码或包含代码的文件（如 cloth.yaml），多个用空格分隔：" << RESET;
+                    std::string line;
+                    std::cin.ignore();
+                    std::getline(std::cin, line);
+                    std::string command = "./tools/AutoMarker";
+                    std::istringstream words(line);
+                    std::string word;
+                    while (words >> word) {
+                        // 按 shell 单引号转义
+                        std::string quoted = "'";
+                        for (char c : word)
+                            quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+                        command += " " + quoted + "'";
+                    }
+                    run_tool(command);
+                    std::cout << "按任意键继续..." << std::endl;
+                    std::cin.get();
+                } else {
+                    run_tool("./tools/AutoMarker");
+                }
                 break;
             }
             case 5: {
                 clearScreen();
                 std::cout << YELLOW << "搜索工具" << RESET << std::endl;
+                std::cout << YELLOW << "1) 完整搜索（列出代码的全部出现位置）" << RESET << std::endl;
+                std::cout << YELLOW << "2) 按特征值位置搜索（使用索引，只查美化工具修改的位置）" << RESET << std::endl;
+                std::cout << BOLD << "请选择对应序号：" << RESET;
+                int search_choice = 0;
+                std::cin >> search_choice;
+                std::cin.ignore();
                 std::cout << CYAN << "开始搜索..." << RESET << std::endl;
-                std::system("./tools/Search");
-                show_loading();
+                run_tool(search_choice == 2 ? "./tools/Search --index" : "./tools/Search");
                 break;
             }
             case 6: {
@@ -253,6 +415,7 @@ int main() {
             }
             case 8: {
                 std::cout << RED << "退出工具..." << RESET << std::endl;
+                stop_servers();
                 return 0;
             }
             default:
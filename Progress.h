@@ -0,0 +1,150 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "Cancel.h"
+
+// 结构化进度通道。Menu 运行工具时创建管道，把写端的描述符号放在环境变量 GFP_PROGRESS_FD 中，
+// 工具在上面逐行写入进度（字段用制表符分隔）：
+//   phase    <阶段名>  <文件总数>  <字节总数>
+//   progress <已完成文件数>  <已完成字节数>  <预计剩余毫秒，未知为 -1>
+//   end      <阶段名>
+// 没有设置环境变量时不输出，工具照常在终端显示自己的进度。
+// 每行都小于 PIPE_BUF，一次 write 写完，多个线程同时汇报也不会交错。
+
+constexpr char kProgressFdEnv[] = "GFP_PROGRESS_FD";
+
+// 环境变量中的进度描述符，没有或已关闭时返回 -1
+inline int progressFdFromEnv() {
+    const char* value = std::getenv(kProgressFdEnv);
+    if (!value || !*value) return -1;
+    char* end = nullptr;
+    long fd = std::strtol(value, &end, 10);
+    if (*end != '\0' || fd < 0 || fd > 65535) return -1;
+    if (::fcntl(static_cast<int>(fd), F_GETFD) == -1) return -1;
+    return static_cast<int>(fd);
+}
+
+// 一次只汇报一个阶段。add / update 可以在工作线程中调用，最多每 kProgressInterval 写一行。
+// 运行已被取消（见 Cancel.h）时 begin 抛出 RunCancelled，不再开始新阶段
+class ProgressReporter {
+public:
+    static constexpr std::chrono::milliseconds kProgressInterval{100};
+
+    // Menu 提前退出时管道没有读端，忽略 SIGPIPE，避免工具在写文件途中被结束
+    ProgressReporter() : fd_(progressFdFromEnv()) {
+        if (enabled()) ::signal(SIGPIPE, SIG_IGN);
+    }
+    ~ProgressReporter() { end(); }
+
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+    bool enabled() const { return fd_ >= 0; }
+
+    void begin(const std::string& phase, uint64_t files, uint64_t bytes) {
+        end();
+        throwIfRunCancelled();
+        phase_ = phase;
+        files_total_ = files;
+        bytes_total_ = bytes;
+        files_done_ = 0;
+        bytes_done_ = 0;
+        start_ = Clock::now();
+        last_emit_ = 0;
+        active_ = true;
+        if (!enabled()) return;
+        char line[256];
+        int n = std::snprintf(line, sizeof(line), "phase\t%s\t%llu\t%llu\n", phase_.c_str(),
+                              static_cast<unsigned long long>(files), static_cast<unsigned long long>(bytes));
+        emit(line, n, sizeof(line));
+    }
+
+    // 累加完成的文件数和字节数
+    void add(uint64_t files, uint64_t bytes) {
+        files_done_ += files;
+        bytes_done_ += bytes;
+        tick(false);
+    }
+
+    // 直接设置完成的文件数和字节数（由主线程轮询计数时使用）
+    void update(uint64_t files, uint64_t bytes) {
+        files_done_ = files;
+        bytes_done_ = bytes;
+        tick(false);
+    }
+
+    // 写出最后的进度并结束当前阶段。
+    // 稍等 Menu 读走通道中的内容（最多 kProgressInterval），让进度行先结束，工具之后的输出不会接在进度行后面
+    void end() {
+        if (!active_) return;
+        active_ = false;
+        if (!enabled()) return;
+        tick(true);
+        char line[256];
+        int n = std::snprintf(line, sizeof(line), "end\t%s\n", phase_.c_str());
+        emit(line, n, sizeof(line));
+        auto deadline = Clock::now() + kProgressInterval;
+        int unread = 0;
+        while (enabled() && ::ioctl(fd_, FIONREAD, &unread) == 0 && unread > 0 && Clock::now() < deadline)
+            ::usleep(1000);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void tick(bool force) {
+        if (!enabled()) return;
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count();
+        int64_t last = last_emit_.load();
+        if (!force) {
+            int64_t interval = std::chrono::nanoseconds(kProgressInterval).count();
+            // 只有一个线程能抢到这次输出
+            if (now - last < interval || !last_emit_.compare_exchange_strong(last, now)) return;
+        }
+        uint64_t files = files_done_.load(), bytes = bytes_done_.load();
+        // 有字节总数时按字节估算剩余时间，否则按文件数
+        uint64_t done = bytes_total_ ? bytes : files;
+        uint64_t total = bytes_total_ ? bytes_total_ : files_total_;
+        long long eta = -1;
+        if (done >= total) {
+            eta = 0;
+        } else if (done > 0) {
+            eta = static_cast<long long>(static_cast<double>(now) / 1e6 * static_cast<double>(total - done) /
+                                         static_cast<double>(done));
+        }
+        char line[128];
+        int n = std::snprintf(line, sizeof(line), "progress\t%llu\t%llu\t%lld\n",
+                              static_cast<unsigned long long>(files), static_cast<unsigned long long>(bytes), eta);
+        emit(line, n, sizeof(line));
+    }
+
+    // n 为 snprintf 的返回值，超出缓冲区的行不写
+    void emit(const char* line, int n, size_t capacity) {
+        if (n <= 0 || static_cast<size_t>(n) >= capacity) return;
+        ssize_t written;
+        while ((written = ::write(fd_, line, static_cast<size_t>(n))) < 0 && errno == EINTR) {
+        }
+        if (written < 0 && errno == EPIPE) fd_ = -1;
+    }
+
+    std::atomic<int> fd_;
+    bool active_ = false;
+    std::string phase_;
+    uint64_t files_total_ = 0;
+    uint64_t bytes_total_ = 0;
+    std::atomic<uint64_t> files_done_{0};
+    std::atomic<uint64_t> bytes_done_{0};
+    std::atomic<int64_t> last_emit_{0};
+    Clock::time_point start_;
+};
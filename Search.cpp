@@ -4,54 +4,127 @@
 #include <vector>
 #include <filesystem>
 #include <algorithm>
-#include <thread>
 #include <atomic>
 #include <mutex>
 #include <chrono>
 #include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+
+#include "MappedFile.h"
+#include "IdMatcher.h"
+#include "WorkStealing.h"
+#include "IdIndex.h"
+#include "ConfigFile.h"
+#include "Progress.h"
 
 namespace fs = std::filesystem;
 
-std::vector<unsigned char> decimalToLittleEndianBytes(int32_t num, size_t byte_length = 4) {
-    std::vector<unsigned char> bytes(byte_length);
-    for (size_t i = 0; i < byte_length; i++) {
-        bytes[i] = static_cast<unsigned char>((num >> (8 * i)) & 0xFF);
+// 每个文件每个代码最多记录的偏移数量，超出部分只计数
+constexpr size_t kMaxOffsetsPerFile = 16;
+
+struct FileHits {
+    std::string file;
+    size_t count = 0;
+    std::vector<uint64_t> offsets;
+};
+
+// 从输入中解析代码：空格、逗号、方括号等分隔，非纯数字的片段（如 "aa78"）会被忽略
+std::vector<int32_t> parseIds(const std::string& text) {
+    std::vector<int32_t> ids;
+    std::string token;
+    auto flush = [&]() {
+        if (token.empty()) return;
+        bool numeric = token.find_first_not_of("0123456789", token[0] == '-' ? 1 : 0) == std::string::npos
+                       && token != "-";
+        if (numeric) {
+            try {
+                long long value = std::stoll(token);
+                if (value >= INT32_MIN && value <= static_cast<long long>(UINT32_MAX))
+                    ids.push_back(static_cast<int32_t>(value));
+            } catch (const std::exception&) {
+            }
+        }
+        token.clear();
+    };
+    for (char c : text) {
+        if (std::isspace(static_cast<unsigned char>(c)) || c == ',' || c == '[' || c == ']' || c == ':')
+            flush();
+        else
+            token += c;
     }
-    return bytes;
+    flush();
+    return ids;
 }
 
-
-bool searchHexInFile(const std::string& filePath, const std::vector<unsigned char>& bytePattern) {
-    std::ifstream file(filePath, std::ios::binary);
-    if (!file) {
+// 单次扫描文件，同时查找 matcher 中的所有代码。hits 按代码下标返回命中信息。
+bool searchIdsInFile(const std::string& filePath, const IdMatcher& matcher,
+                     std::vector<std::pair<size_t, FileHits>>& hits,
+                     ScanMode mode = ScanMode::Auto) {
+    std::unordered_map<size_t, FileHits> local;
+    bool readable = scanFileChunks(filePath, 3,
+        [&](const unsigned char* data, size_t length, uint64_t base) {
+            matcher.scan(data, length, [&](size_t index, size_t pos) {
+                FileHits& fh = local[index];
+                fh.count++;
+                if (fh.offsets.size() < kMaxOffsetsPerFile)
+                    fh.offsets.push_back(base + pos);
+                return true;
+            });
+            return true;
+        }, mode);
+    if (!readable) {
         std::cerr << "无法读取文件 " << filePath << std::endl;
         return false;
     }
-    std::vector<unsigned char> content((std::istreambuf_iterator<char>(file)),
-                                        std::istreambuf_iterator<char>());
-    if (content.size() < bytePattern.size()) return false;
-    auto it = std::search(content.begin(), content.end(),
-                          bytePattern.begin(), bytePattern.end());
-    return it != content.end();
+    for (auto& [index, fh] : local) {
+        fh.file = filePath;
+        hits.emplace_back(index, std::move(fh));
+    }
+    return true;
 }
 
-void workerFunction(const std::vector<std::string>& files,
-                    const std::vector<unsigned char>& bytePattern,
-                    std::atomic<size_t>& progress,
-                    std::vector<std::string>& matches,
-                    std::mutex& matchesMutex,
-                    size_t start, size_t end)
-{
-    for (size_t i = start; i < end; i++) {
-        if (searchHexInFile(files[i], bytePattern)) {
-            std::lock_guard<std::mutex> lock(matchesMutex);
-            matches.push_back(files[i]);
+// 配置中 hex_markers 段的特征值，没有或不是十六进制时为空
+std::vector<unsigned char> configMarker(const std::string& path, const std::string& key) {
+    std::vector<unsigned char> bytes;
+    ConfigFile config;
+    const std::string* value = loadConfigFile(path, config) ? config.value("hex_markers", key) : nullptr;
+    if (!value || value->size() % 2 != 0) return bytes;
+    for (size_t i = 0; i < value->size(); i += 2) {
+        std::string digits = value->substr(i, 2);
+        char* end = nullptr;
+        long byte = std::strtol(digits.c_str(), &end, 16);
+        if (*end != '\0') return {};
+        bytes.push_back(static_cast<unsigned char>(byte));
+    }
+    return bytes;
+}
+
+// 从索引中取出各代码的命中文件和偏移。索引只收录特征值定位的位置（代码在文件其他地方的出现不在其中），
+// count 是这些位置的个数
+void searchIdsInIndex(const IdIndex& index, const IdMatcher& matcher,
+                      std::vector<std::vector<FileHits>>& results) {
+    for (size_t i = 0; i < matcher.size(); i++) {
+        auto [begin, end] = index.lookup(static_cast<uint32_t>(matcher.id(i)));
+        for (const uint64_t* p = begin; p != end; ++p) {
+            uint32_t file = postingFile(*p);
+            if (results[i].empty() || results[i].back().file != index.filePath(file)) {
+                results[i].emplace_back();
+                results[i].back().file = std::string(index.filePath(file));
+            }
+            FileHits& fh = results[i].back();
+            fh.count++;
+            if (fh.offsets.size() < kMaxOffsetsPerFile)
+                fh.offsets.push_back(postingOffset(*p));
         }
-        progress++;
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    bool indexMode = argc > 1 && std::string(argv[1]) == "--index";
 
     std::cout << "请输入要搜索的 .dat 文件所在的目录路径（留空使用默认路径 '解包数据/dat'）: ";
     std::string directoryToSearch;
@@ -64,16 +137,36 @@ int main() {
         return 1;
     }
 
-    std::vector<int32_t> decimalNumbers = {333600100};
-    std::vector<unsigned char> bytePattern = decimalToLittleEndianBytes(decimalNumbers[0]);
+    std::cout << "请输入要搜索的代码，多个代码用空格或逗号分隔，也可以填写包含代码的文件路径（留空使用默认 333600100）: ";
+    std::string idInput;
+    std::getline(std::cin, idInput);
+    std::vector<int32_t> decimalNumbers;
+    if (idInput.empty()) {
+        decimalNumbers = {333600100};
+    } else if (fs::is_regular_file(idInput)) {
+        std::ifstream idFile(idInput);
+        std::string text((std::istreambuf_iterator<char>(idFile)), std::istreambuf_iterator<char>());
+        decimalNumbers = parseIds(text);
+    } else {
+        decimalNumbers = parseIds(idInput);
+    }
+    if (decimalNumbers.empty()) {
+        std::cerr << "错误: 未输入有效的代码。" << std::endl;
+        return 1;
+    }
+    IdMatcher matcher(decimalNumbers);
 
     std::vector<std::string> datFiles;
+    std::vector<uint64_t> datSizes;
     for (const auto& entry : fs::recursive_directory_iterator(directoryToSearch)) {
         if (entry.is_regular_file()) {
             std::string ext = entry.path().extension().string();
             std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
             if (ext == ".dat") {
                 datFiles.push_back(entry.path().string());
+                std::error_code ec;
+                uint64_t size = entry.file_size(ec);
+                datSizes.push_back(ec ? 0 : size);
             }
         }
     }
@@ -82,44 +175,128 @@ int main() {
         return 0;
     }
 
-    const size_t numThreads = 8;
+    // --index：只查特征值定位的位置（美化工具修改的位置），先增量更新索引再查询，索引中没有的代码直接扫描。
+    // 需要 cloth.yaml 或 伪实体配置.yaml 中的特征值。默认完整扫描，列出代码的全部出现位置
+    std::string indexPath = indexPathFor(directoryToSearch);
+    IndexMarkers markers;
+    bool useIndex = false;
+    if (indexMode) {
+        markers.skin_start = configMarker("cloth.yaml", "start");
+        markers.skin_end = configMarker("cloth.yaml", "end");
+        markers.entity_start = configMarker("伪实体配置.yaml", "start");
+        markers.entity_end = configMarker("伪实体配置.yaml", "end");
+        useIndex = !markers.empty();
+        if (!useIndex) std::cerr << "配置中没有特征值，无法使用索引，改为完整扫描。" << std::endl;
+    }
+
+    // 按文件大小从大到小调度，线程数跟随 CPU 核数，空闲线程会窃取其他线程的任务
+    WorkStealingPool pool;
     std::atomic<size_t> progress(0);
-    std::vector<std::string> matches;
-    std::mutex matchesMutex;
+    std::atomic<uint64_t> progressBytes(0);
     size_t totalFiles = datFiles.size();
-    std::vector<std::thread> workers;
-    size_t filesPerThread = (totalFiles + numThreads - 1) / numThreads;
-
-    for (size_t t = 0; t < numThreads; t++) {
-        size_t start = t * filesPerThread;
-        size_t end = std::min(start + filesPerThread, totalFiles);
-        if (start < end) {
-            workers.emplace_back(workerFunction,
-                                 std::cref(datFiles),
-                                 std::cref(bytePattern),
-                                 std::ref(progress),
-                                 std::ref(matches),
-                                 std::ref(matchesMutex),
-                                 start, end);
+    uint64_t totalBytes = 0;
+    for (uint64_t size : datSizes) totalBytes += size;
+    std::vector<std::vector<FileHits>> results(matcher.size());
+    std::vector<char> fromIndex(matcher.size());  // 结果来自索引（只有特征值定位的位置）
+    // 需要直接扫描的代码
+    std::vector<int32_t> scanIds;
+    for (size_t i = 0; i < matcher.size(); i++) scanIds.push_back(matcher.id(i));
+    // 有进度通道（从 Menu 运行）时由 Menu 显示进度，否则在终端显示
+    ProgressReporter reporter;
+    auto showProgress = [&](const char* label) {
+        reporter.update(progress.load(), progressBytes.load());
+        if (!reporter.enabled())
+            std::cout << "\r" << label << ": " << progress.load() << "/" << totalFiles << " 个文件已处理" << std::flush;
+    };
+
+    if (useIndex) {
+        reporter.begin("更新索引", totalFiles, totalBytes);
+        IndexUpdateStats stats = updateIdIndex(indexPath, datFiles, markers, pool, &progress, &progressBytes,
+                                               [&]() { showProgress("索引进度"); });
+        reporter.update(progress.load(), progressBytes.load());
+        reporter.end();
+        std::cout << (reporter.enabled() ? "" : "\r") << "索引进度: " << totalFiles << "/" << totalFiles
+                  << " 个文件已处理（重新扫描 " << stats.scanned << " 个）" << std::endl;
+        IdIndex index;
+        if (index.open(indexPath)) {
+            searchIdsInIndex(index, matcher, results);
+            scanIds.clear();
+            for (size_t i = 0; i < matcher.size(); i++) {
+                if (results[i].empty())
+                    scanIds.push_back(matcher.id(i));
+                else
+                    fromIndex[i] = 1;
+            }
+            size_t indexed = matcher.size() - scanIds.size();
+            std::cout << "索引中找到 " << indexed << " 个代码的特征值位置";
+            if (!scanIds.empty()) std::cout << "，其余 " << scanIds.size() << " 个代码直接扫描";
+            std::cout << "。" << std::endl;
+        } else {
+            std::cerr << "索引不可用，改为直接扫描。" << std::endl;
         }
+        progress = 0;
+        progressBytes = 0;
     }
 
-    while (progress < totalFiles) {
-        std::cout << "\r搜索进度: " << progress.load() << "/" << totalFiles << " 个文件已处理" << std::flush;
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    }
-    std::cout << "\r搜索进度: " << totalFiles << "/" << totalFiles << " 个文件已处理" << std::endl;
+    if (!scanIds.empty()) {
+        IdMatcher scanMatcher(scanIds);
+        reporter.begin("搜索 dat", totalFiles, totalBytes);
+        std::vector<std::vector<std::pair<size_t, FileHits>>> workerHits(pool.size());
+        // 调用线程每 200 毫秒显示一次进度，任务的异常由 pool.run 重新抛出
+        pool.run(datSizes, [&](size_t worker, size_t task) {
+            searchIdsInFile(datFiles[task], scanMatcher, workerHits[worker]);
+            progressBytes += datSizes[task];
+            progress++;
+        }, [&]() { showProgress("搜索进度"); }, std::chrono::milliseconds(200));
+        reporter.update(progress.load(), progressBytes.load());
+        reporter.end();
+        if (!reporter.enabled())
+            std::cout << "\r搜索进度: " << totalFiles << "/" << totalFiles << " 个文件已处理" << std::endl;
 
-    for (auto& th : workers) {
-        if (th.joinable()) {
-            th.join();
+        for (auto& hits : workerHits) {
+            for (auto& [index, fh] : hits)
+                results[matcher.find(static_cast<uint32_t>(scanMatcher.id(index)))].push_back(std::move(fh));
         }
     }
 
+    std::set<std::string> matches;
+    for (auto& fileHits : results) {
+        std::sort(fileHits.begin(), fileHits.end(),
+                  [](const FileHits& a, const FileHits& b) { return a.file < b.file; });
+        for (const auto& fh : fileHits)
+            matches.insert(fh.file);
+    }
+
     std::cout << "找到包含美化的文件:" << std::endl;
     for (const auto& match : matches) {
         std::cout << " - " << match << std::endl;
     }
+
+    std::cout << "\n按代码统计:" << std::endl;
+    size_t foundIds = 0;
+    std::set<int32_t> reported;
+    for (int32_t number : decimalNumbers) {
+        int index = matcher.find(static_cast<uint32_t>(number));
+        if (index < 0 || !reported.insert(number).second) continue;
+        const auto& fileHits = results[index];
+        if (fileHits.empty()) {
+            std::cout << "代码 " << number << "：未找到" << std::endl;
+            continue;
+        }
+        foundIds++;
+        std::cout << "代码 " << number << "：" << fileHits.size() << " 个文件"
+                  << (fromIndex[index] ? "（索引，仅特征值定位的位置）" : "") << std::endl;
+        for (const auto& fh : fileHits) {
+            std::cout << "   - " << fh.file << "（" << fh.count << " 处：";
+            for (size_t k = 0; k < fh.offsets.size(); k++) {
+                if (k) std::cout << ", ";
+                std::cout << "0x" << std::hex << fh.offsets[k] << std::dec;
+            }
+            if (fh.count > fh.offsets.size()) std::cout << ", ...";
+            std::cout << "）" << std::endl;
+        }
+    }
+    std::cout << "命中 " << foundIds << "/" << matcher.size() << " 个代码" << std::endl;
     std::cout << "搜索完毕。" << std::endl;
     return 0;
 }
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "ByteSearch.h"
+
+// 解包数据中两种可修改的数据布局：衣服/载具块（fast）和伪实体图标映射（AutoSwitchSkinIcon）。
+// 工具和代码目录（IdCatalog.h）共用这里的查找逻辑，保证目录的结果与工具实际能修改的一致。
+
+inline uint32_t loadLE32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+inline void storeLE32(uint32_t value, unsigned char* out) {
+    for (int i = 0; i < 4; i++)
+        out[i] = static_cast<unsigned char>((value >> (8 * i)) & 0xFF);
+}
+
+// 载具代码：十进制末尾补 "00"，即乘以 100；溢出 32 位时没有对应代码
+inline std::optional<uint32_t> vehicleKey(uint32_t value) {
+    uint64_t key = static_cast<uint64_t>(value) * 100;
+    if (key > 0xFFFFFFFF)
+        return std::nullopt;
+    return static_cast<uint32_t>(key);
+}
+
+// ========== 衣服/载具块 ==========
+// 起始特征值与结束特征值之间恰好 14 字节，结束特征值之后再跳过 15 字节是第一个目标值。
+// 其后出现的同一个值构成衣服块（对称），出现的 ×100 值构成载具块。
+// dat 中伪实体的代码同样跟在一对相隔 14 字节的特征值之后，只是跳过 23 字节（见 AutoMarker）。
+
+constexpr size_t kBlockMarkerGap = 14;
+constexpr size_t kBlockTargetSkip = 15;
+constexpr size_t kEntityTargetSkip = 23;
+
+struct BlockMatch {
+    uint32_t first_value;
+    size_t first_position;
+    size_t cloth_position;    // 对称的第二个目标值，没有时为 npos
+    uint32_t vehicle_value;
+    size_t vehicle_position;  // ×100 的目标值，没有时为 npos
+};
+
+// 每对相隔 kBlockMarkerGap 字节的起止特征值只找一次，回调结束特征值之后跳过 skip 字节的 4 字节代码：
+// fn(代码, 位置)
+template <class Fn>
+void forEachMarkedValue(const unsigned char* data, size_t size,
+                        const std::vector<unsigned char>& start_marker,
+                        const std::vector<unsigned char>& end_marker,
+                        size_t skip, Fn&& fn) {
+    if (start_marker.empty() || end_marker.empty()) return;
+    size_t idx_start = 0;
+    while (idx_start < size) {
+        size_t start_idx = bytesearch::findBytes(data, size, start_marker.data(), start_marker.size(), idx_start);
+        if (start_idx == bytesearch::npos) break;
+        size_t end_idx = bytesearch::findBytes(data, size, end_marker.data(), end_marker.size(),
+                                               start_idx + start_marker.size());
+        if (end_idx == bytesearch::npos) break;
+        if (end_idx - (start_idx + start_marker.size()) == kBlockMarkerGap) {
+            size_t target_start_idx = end_idx + end_marker.size() + skip;
+            if (target_start_idx + 4 > size) break;
+            fn(loadLE32(data + target_start_idx), target_start_idx);
+        }
+        idx_start = end_idx + end_marker.size();
+    }
+}
+
+// 单次遍历查找全部块：每对起止特征值只找一次，之后分别查找衣服块和载具块的第二个目标值。
+// 两者都没有找到的位置也会回调。
+template <class Fn>
+void forEachBlock(const unsigned char* data, size_t size,
+                  const std::vector<unsigned char>& start_marker,
+                  const std::vector<unsigned char>& end_marker,
+                  Fn&& fn) {
+    forEachMarkedValue(data, size, start_marker, end_marker, kBlockTargetSkip, [&](uint32_t value, size_t pos) {
+        const unsigned char* first_target = data + pos;
+        size_t block_start = pos + 4;
+
+        BlockMatch match;
+        match.first_value = value;
+        match.first_position = pos;
+        match.cloth_position = bytesearch::findBytesFixed<4>(data, size, first_target, block_start);
+        match.vehicle_value = 0;
+        match.vehicle_position = bytesearch::npos;
+        auto vehicle_value = vehicleKey(value);
+        if (vehicle_value.has_value()) {
+            unsigned char second_target[4];
+            storeLE32(*vehicle_value, second_target);
+            match.vehicle_value = *vehicle_value;
+            match.vehicle_position = bytesearch::findBytesFixed<4>(data, size, second_target, block_start);
+        }
+        fn(match);
+    });
+}
+
+// ========== 伪实体图标映射 ==========
+// 代码附近最近的一对起止特征值之间的字节是映射，长度为 kMappingLength 时可以交换。
+
+constexpr size_t kMappingLength = 14;
+
+// 文件中起止特征值的全部位置（升序）。每个文件只扫描一次，查找和写入阶段共用
+struct MarkerIndex {
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> ends;
+};
+
+inline MarkerIndex buildMarkerIndex(const unsigned char* data, size_t size,
+                                    const std::vector<unsigned char>& start_marker,
+                                    const std::vector<unsigned char>& end_marker) {
+    MarkerIndex index;
+    bytesearch::forEachMatch(data, size, start_marker.data(), start_marker.size(), [&](size_t pos) {
+        index.starts.push_back(pos);
+        return true;
+    });
+    bytesearch::forEachMatch(data, size, end_marker.data(), end_marker.size(), [&](size_t pos) {
+        index.ends.push_back(pos);
+        return true;
+    });
+    return index;
+}
+
+// 二分查找离 target 最近的位置，距离相同时取较小的位置
+inline uint64_t nearestPosition(const std::vector<uint64_t>& positions, uint64_t target) {
+    auto it = std::lower_bound(positions.begin(), positions.end(), target);
+    if (it == positions.end())
+        return positions.back();
+    if (it == positions.begin())
+        return *it;
+    uint64_t after = *it, before = *(it - 1);
+    return target - before <= after - target ? before : after;
+}
+
+// 取离目标代码最近的一对起止特征值，返回映射数据的位置和长度
+inline std::optional<std::pair<uint64_t, uint64_t>> locateMapping(const MarkerIndex& markers,
+                                                                  size_t marker_length,
+                                                                  uint64_t target_position) {
+    if (markers.starts.empty() || markers.ends.empty())
+        return std::nullopt;
+    uint64_t closest_start = nearestPosition(markers.starts, target_position);
+    uint64_t closest_end = nearestPosition(markers.ends, target_position);
+    if (closest_start > closest_end)
+        std::swap(closest_start, closest_end);
+    if (closest_end < closest_start + marker_length)
+        return std::nullopt;
+    return std::make_pair(closest_start + marker_length, closest_end - (closest_start + marker_length));
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <string>
+#include <set>
+#include <mutex>
+#include <vector>
+#include <filesystem>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#if defined(__linux__)
+#include <linux/fs.h>
+#endif
+
+// 复制单个文件：优先 reflink（FICLONE，btrfs/xfs/f2fs 等支持时几乎零成本），
+// 其次内核内的 copy_file_range，最后退回普通的读写复制。
+// 注意这里从不使用硬链接，之后对目标文件的原地修改不会影响源文件。
+inline bool cloneFile(const std::string& from, const std::string& to) {
+    int src = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src < 0) return false;
+    struct stat st;
+    if (::fstat(src, &st) != 0) {
+        ::close(src);
+        return false;
+    }
+    int dst = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777);
+    if (dst < 0) {
+        ::close(src);
+        return false;
+    }
+    bool ok = false;
+#ifdef FICLONE
+    ok = ::ioctl(dst, FICLONE, src) == 0;
+#endif
+    off_t copied = 0;
+#ifdef __NR_copy_file_range
+    if (!ok) {
+        while (copied < st.st_size) {
+            long n = ::syscall(__NR_copy_file_range, src, nullptr, dst, nullptr,
+                               static_cast<size_t>(st.st_size - copied), 0u);
+            if (n <= 0) break;
+            copied += n;
+        }
+        ok = copied == st.st_size;
+    }
+#endif
+    if (!ok) {
+        // 从已复制的位置继续普通复制
+        ::lseek(src, copied, SEEK_SET);
+        ::lseek(dst, copied, SEEK_SET);
+        std::vector<char> buffer(1 << 20);
+        ok = true;
+        while (true) {
+            ssize_t n = ::read(src, buffer.data(), buffer.size());
+            if (n == 0) break;
+            if (n < 0 || ::write(dst, buffer.data(), static_cast<size_t>(n)) != n) {
+                ok = false;
+                break;
+            }
+        }
+    }
+    ::close(src);
+    if (::close(dst) != 0) ok = false;
+    return ok;
+}
+
+// 延迟暂存：直接在源目录（解包数据/uexp）上扫描，只有确定要修改的文件才复制到目标目录（打包/uexp），
+// 而不是先整体复制、改完再把没改的删掉。flatten 为 true 时目标目录不保留子目录结构。
+class LazyStaging {
+public:
+    LazyStaging(const std::string& source_root, const std::string& destination_root, bool flatten = false)
+        : source_root_(std::filesystem::absolute(source_root).lexically_normal()),
+          destination_root_(destination_root),
+          flatten_(flatten) {}
+
+    const std::filesystem::path& sourceRoot() const { return source_root_; }
+    const std::filesystem::path& destinationRoot() const { return destination_root_; }
+
+    // 清空并重新创建目标目录
+    void reset() {
+        namespace fs = std::filesystem;
+        if (fs::exists(destination_root_))
+            fs::remove_all(destination_root_);
+        fs::create_directories(destination_root_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        materialized_.clear();
+    }
+
+    std::string destinationFor(const std::string& source) const {
+        namespace fs = std::filesystem;
+        fs::path abs = fs::absolute(source).lexically_normal();
+        if (flatten_) return (destination_root_ / abs.filename()).string();
+        fs::path rel = abs.lexically_relative(source_root_);
+        if (rel.empty() || *rel.begin() == "..") rel = abs.filename();
+        return (destination_root_ / rel).string();
+    }
+
+    // 把源文件复制到目标位置（同一个文件只复制一次，线程安全），返回目标路径；失败时返回空串
+    std::string materialize(const std::string& source) {
+        namespace fs = std::filesystem;
+        std::string dest = destinationFor(source);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (materialized_.count(dest)) return dest;
+        std::error_code ec;
+        fs::create_directories(fs::path(dest).parent_path(), ec);
+        if (!cloneFile(source, dest)) return "";
+        materialized_.insert(dest);
+        return dest;
+    }
+
+private:
+    std::filesystem::path source_root_;
+    std::filesystem::path destination_root_;
+    bool flatten_;
+    std::mutex mutex_;
+    std::set<std::string> materialized_;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+// 把按配置顺序排列的交换对合成为一个置换。
+// 交换对按值解释：(a, b) 交换当前持有 a 和持有 b 的两个位置，链式、循环交换得到的总是一个置换。
+// （与按位置逐对交换、只改写仍是原值的位置不同，同一个值出现在多个交换对中时结果会不一样）
+// 每个位置以它原来的值命名；全部交换对处理完后，只需把每个位置改写成它最终持有的值，
+// 每个文件扫描、写入一次即可，不再依赖逐对读写的中间状态。
+class SwapPermutation {
+public:
+    void swap(uint64_t a, uint64_t b) {
+        pairs_.emplace_back(a, b);
+        if (a == b) return;
+        uint64_t slot_a = holder(a), slot_b = holder(b);
+        holder_[a] = slot_b;
+        holder_[b] = slot_a;
+        value_[slot_a] = b;
+        value_[slot_b] = a;
+    }
+
+    // 位置 slot 最终持有的值（没有参与交换时就是它自己）
+    uint64_t valueAt(uint64_t slot) const {
+        auto it = value_.find(slot);
+        return it == value_.end() ? slot : it->second;
+    }
+
+    // 最终值与原值不同的位置：(位置, 最终值)，按位置排序
+    std::vector<std::pair<uint64_t, uint64_t>> changes() const {
+        std::vector<std::pair<uint64_t, uint64_t>> result;
+        for (const auto& [slot, value] : value_)
+            if (value != slot) result.emplace_back(slot, value);
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // 出现在多个交换对中的值（链式或循环交换），结果取决于交换对的顺序，按首次出现的顺序返回
+    std::vector<uint64_t> conflicts() const {
+        std::unordered_map<uint64_t, size_t> uses;
+        std::vector<uint64_t> order;
+        auto use = [&](uint64_t v) {
+            if (uses[v]++ == 0) order.push_back(v);
+        };
+        for (const auto& [a, b] : pairs_) {
+            use(a);
+            if (b != a) use(b);
+        }
+        std::vector<uint64_t> result;
+        for (uint64_t v : order)
+            if (uses[v] > 1) result.push_back(v);
+        return result;
+    }
+
+private:
+    uint64_t holder(uint64_t value) const {
+        auto it = holder_.find(value);
+        return it == holder_.end() ? value : it->second;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> pairs_;
+    std::unordered_map<uint64_t, uint64_t> holder_;   // 值 -> 当前持有它的位置
+    std::unordered_map<uint64_t, uint64_t> value_;    // 位置 -> 当前持有的值
+};
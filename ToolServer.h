@@ -0,0 +1,484 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <iostream>
+#include <filesystem>
+#include <exception>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <climits>
+#include <stdio_ext.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "Cancel.h"
+#include "Progress.h"
+
+// 常驻服务：工具以 --serve 启动后在 UNIX 套接字上等待请求，进程内的缓存（如 fast 的块表）在多次运行之间保留。
+// 直接运行工具时先尝试连接服务：连接成功就把本进程的标准输入、输出、错误、当前目录（以及进度通道，见 Progress.h）交给服务，
+// 由服务在自己的进程里完成这次运行并返回退出码；没有服务时照常在本进程运行。
+//
+// 每个工作目录（项目目录）一个服务，套接字放在 $TMPDIR（默认 /tmp）下本用户专用的 gfp-<uid> 目录（权限 0700）中，
+// 按工具名和目录哈希命名。请求会把终端和项目目录交给服务，所以目录、套接字和连接的另一端都必须属于当前用户：
+// 目录不是本用户的 0700 目录时不使用服务，双方连接后都用 SO_PEERCRED 核对对方的 uid。
+// 服务一次只处理一个请求，空闲超过 kServeIdleSeconds 秒后自动退出；--stop 让服务立即退出。
+//
+// 请求带有客户端可执行文件的标识（见 binaryIdentity）。工具重新编译或替换后标识不同，旧服务不再运行请求，
+// 回复 kStaleServer 后退出，客户端改为直接运行；新的 --serve 遇到旧服务时同样让它退出再接管套接字。
+// 运行期间客户端退出（Ctrl-C、Menu 结束工具）时连接断开，服务取消这次运行（见 HangupWatcher），
+// 工具在下一个扫描阶段的边界上停下，不会用不完整的扫描结果写文件，服务本身和其中的缓存保留，下一次运行照常使用。
+
+namespace toolserver {
+
+constexpr int kServeIdleSeconds = 30 * 60;
+// 服务与客户端不是同一个程序时的回复
+constexpr int32_t kStaleServer = INT32_MIN;
+// 运行中客户端断开、这次运行被取消时的退出码（与被 SIGINT 结束时 shell 报告的一致）
+constexpr int kClientGoneExitCode = 130;
+
+// 本进程可执行文件的标识：设备、inode、大小和修改时间的哈希
+inline uint64_t binaryIdentity() {
+    struct stat st{};
+    if (::stat("/proc/self/exe", &st) != 0) return 0;
+    const uint64_t fields[] = {static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino),
+                               static_cast<uint64_t>(st.st_size), static_cast<uint64_t>(st.st_mtim.tv_sec),
+                               static_cast<uint64_t>(st.st_mtim.tv_nsec)};
+    uint64_t h = 1469598103934665603ull;
+    for (uint64_t field : fields) {
+        for (int i = 0; i < 8; i++) {
+            h ^= (field >> (i * 8)) & 0xFF;
+            h *= 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+// 本用户的套接字目录，不存在时创建；已存在但不是本用户的 0700 目录（或是符号链接）时返回空
+inline std::string privateDirectory() {
+    const char* tmp = std::getenv("TMPDIR");
+    std::string dir = std::string(tmp && *tmp ? tmp : "/tmp") + "/gfp-" + std::to_string(::getuid());
+    if (::mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) return "";
+    struct stat st{};
+    if (::lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != ::getuid() ||
+        (st.st_mode & 077) != 0)
+        return "";
+    return dir;
+}
+
+// 套接字路径，无法使用私有目录时返回空
+inline std::string socketPath(const std::string& tool) {
+    std::string dir = privateDirectory();
+    if (dir.empty()) return "";
+    std::error_code ec;
+    std::string cwd = std::filesystem::current_path(ec).string();
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : cwd) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    char name[96];
+    std::snprintf(name, sizeof(name), "/gfp-%s-%016llx.sock", tool.c_str(), static_cast<unsigned long long>(h));
+    return dir + name;
+}
+
+inline bool makeAddress(const std::string& path, sockaddr_un& addr) {
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// 连接的另一端是否属于当前用户
+inline bool peerIsSelf(int fd) {
+    ucred cred{};
+    socklen_t length = sizeof(cred);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) == 0 && cred.uid == ::getuid();
+}
+
+// 只连接本用户创建的套接字，连接后再核对服务进程的 uid
+inline int connectTo(const std::string& path) {
+    sockaddr_un addr;
+    if (!makeAddress(path, addr)) return -1;
+    struct stat st{};
+    if (::lstat(path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode) || st.st_uid != ::getuid()) return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || !peerIsSelf(fd)) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 随 run 命令传递的描述符：标准输入、输出、错误、当前目录，有进度通道时再加上进度描述符
+constexpr int kPassedFds = 4;
+constexpr int kMaxPassedFds = kPassedFds + 1;
+
+inline bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+inline bool readAll(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = ::read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// 命令：'r' 运行，'s' 停止，'p' 只核对标识（--serve 启动时检查已有的服务）
+// 命令字节之后是可执行文件标识、参数个数和各参数（长度 + 内容）
+constexpr uint32_t kMaxArgs = 4096;
+constexpr uint32_t kMaxArgLength = 1 << 20;
+
+// 发送命令，run 命令同时附带本进程的 0、1、2 号描述符、当前目录和进度描述符
+inline bool sendCommand(int fd, char command, const std::vector<std::string>& args) {
+    msghdr msg{};
+    iovec iov{&command, 1};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(kMaxPassedFds * sizeof(int))];
+    int cwd = -1;
+    if (command == 'r') {
+        cwd = ::open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (cwd < 0) return false;
+        int fds[kMaxPassedFds] = {0, 1, 2, cwd, progressFdFromEnv()};
+        size_t count = fds[kPassedFds] >= 0 ? kMaxPassedFds : kPassedFds;
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+    }
+    bool ok = ::sendmsg(fd, &msg, MSG_NOSIGNAL) == 1;
+    if (cwd >= 0) ::close(cwd);
+    if (!ok) return false;
+    std::string body;
+    uint64_t identity = binaryIdentity();
+    uint32_t count = static_cast<uint32_t>(args.size());
+    body.append(reinterpret_cast<const char*>(&identity), sizeof(identity));
+    body.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const auto& arg : args) {
+        uint32_t length = static_cast<uint32_t>(arg.size());
+        body.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        body += arg;
+    }
+    return writeAll(fd, body.data(), body.size());
+}
+
+// 接收命令、附带的描述符、客户端标识和参数，没有描述符时 fds 为 -1
+inline bool receiveCommand(int fd, char& command, int fds[kMaxPassedFds], uint64_t& identity,
+                           std::vector<std::string>& args) {
+    for (int i = 0; i < kMaxPassedFds; i++) fds[i] = -1;
+    msghdr msg{};
+    iovec iov{&command, 1};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(kMaxPassedFds * sizeof(int))];
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) != 1) return false;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        if (count == kPassedFds || count == kMaxPassedFds) {
+            std::memcpy(fds, CMSG_DATA(cmsg), count * sizeof(int));
+        } else {
+            // 个数不对时全部关闭，按没有描述符处理
+            for (size_t i = 0; i < count; i++) {
+                int unexpected;
+                std::memcpy(&unexpected, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                ::close(unexpected);
+            }
+        }
+    }
+    uint32_t count = 0;
+    if (!readAll(fd, &identity, sizeof(identity)) || !readAll(fd, &count, sizeof(count)) || count > kMaxArgs)
+        return false;
+    args.resize(count);
+    for (auto& arg : args) {
+        uint32_t length = 0;
+        if (!readAll(fd, &length, sizeof(length)) || length > kMaxArgLength) return false;
+        arg.resize(length);
+        if (length > 0 && !readAll(fd, &arg[0], length)) return false;
+    }
+    return true;
+}
+
+// 运行期间在后台线程中等待客户端断开。断开时取消这次运行（见 Cancel.h）：标准输入输出和进度描述符换成 /dev/null，
+// 不再读写已经离开的客户端的终端；再向运行工具的线程发送 kInterruptSignal，打断它在终端上阻塞的读取。
+// 工具在下一个扫描阶段的边界上结束，服务回到 accept，进程内的缓存保留
+constexpr int kInterruptSignal = SIGUSR1;
+
+class HangupWatcher {
+public:
+    HangupWatcher(int client, int progress_fd) {
+        if (::pipe2(stop_, O_CLOEXEC) != 0) return;
+        pthread_t runner = ::pthread_self();
+        thread_ = std::thread([client, progress_fd, runner, this] {
+            pollfd p[2] = {{client, POLLRDHUP, 0}, {stop_[0], POLLIN, 0}};
+            while (true) {
+                int ready = ::poll(p, 2, -1);
+                if (ready < 0 && errno == EINTR) continue;
+                if (ready < 0 || p[1].revents) return;
+                if (p[0].revents & (POLLRDHUP | POLLHUP | POLLERR)) {
+                    runCancelFlag() = true;
+                    int null = ::open("/dev/null", O_RDWR | O_CLOEXEC);
+                    if (null >= 0) {
+                        for (int fd : {0, 1, 2, progress_fd})
+                            if (fd >= 0) ::dup2(null, fd);
+                        ::close(null);
+                    }
+                    ::pthread_kill(runner, kInterruptSignal);
+                    return;
+                }
+            }
+        });
+    }
+    ~HangupWatcher() {
+        if (!thread_.joinable()) return;
+        (void)::write(stop_[1], "", 1);
+        thread_.join();
+        ::close(stop_[0]);
+        ::close(stop_[1]);
+    }
+
+    HangupWatcher(const HangupWatcher&) = delete;
+    HangupWatcher& operator=(const HangupWatcher&) = delete;
+
+private:
+    int stop_[2] = {-1, -1};
+    std::thread thread_;
+};
+
+// 把客户端的标准输入输出换到 0、1、2 上、切换到客户端的当前目录运行一次，结束后恢复。
+// 项目目录被删除重建后服务原来的目录已失效，所以每次都切换到客户端传来的目录。
+// 客户端有进度通道时，运行期间把收到的描述符写进环境变量，工具照常从环境变量取得。
+// run 收到的参数与客户端相同（argv[0] 为工具名）。运行期间客户端断开时返回 kClientGoneExitCode
+template <class Run>
+int runWithStdio(int client, const int fds[kMaxPassedFds], const std::string& tool,
+                 const std::vector<std::string>& args, Run& run) {
+    int saved_cwd = ::open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (::fchdir(fds[3]) != 0) {
+        if (saved_cwd >= 0) ::close(saved_cwd);
+        return 1;
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    int saved[3];
+    for (int i = 0; i < 3; i++) {
+        saved[i] = ::dup(i);
+        ::dup2(fds[i], i);
+    }
+    // 丢掉上一个客户端留在缓冲区中没读完的输入
+    __fpurge(stdin);
+    std::clearerr(stdin);
+    std::cin.clear();
+    if (fds[kPassedFds] >= 0)
+        ::setenv(kProgressFdEnv, std::to_string(fds[kPassedFds]).c_str(), 1);
+    else
+        ::unsetenv(kProgressFdEnv);
+    std::vector<std::string> strings;
+    strings.push_back(tool);
+    strings.insert(strings.end(), args.begin(), args.end());
+    std::vector<char*> argv;
+    for (auto& arg : strings) argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+    int code = 1;
+    runCancelFlag() = false;
+    {
+        HangupWatcher watcher(client, fds[kPassedFds]);
+        try {
+            code = run(static_cast<int>(strings.size()), argv.data());
+        } catch (const RunCancelled&) {
+            code = kClientGoneExitCode;
+        } catch (const std::exception& e) {
+            std::cerr << "发生错误：" << e.what() << "\n";
+            code = 1;
+        } catch (...) {
+            // 任何异常都不能越过下面恢复标准输入输出和工作目录的代码
+            std::cerr << "发生未知错误\n";
+            code = 1;
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(nullptr);
+    }
+    if (runCancelled()) code = kClientGoneExitCode;
+    ::unsetenv(kProgressFdEnv);
+    for (int i = 0; i < 3; i++) {
+        ::dup2(saved[i], i);
+        ::close(saved[i]);
+    }
+    if (saved_cwd >= 0) {
+        (void)::fchdir(saved_cwd);
+        ::close(saved_cwd);
+    }
+    return code;
+}
+
+// 交换一次命令，返回服务的回复；连接中断时返回 -1
+inline int exchange(int fd, char command, const std::vector<std::string>& args) {
+    int32_t code = -1;
+    if (!sendCommand(fd, command, args)) return -1;
+    if (!readAll(fd, &code, sizeof(code))) return -1;
+    return code;
+}
+
+// 本进程绑定的套接字文件的 inode
+inline ino_t& ownSocketInode() {
+    static ino_t inode = 0;
+    return inode;
+}
+
+// 只删除本进程创建的套接字，不误删接管后的新服务的套接字
+inline void removeOwnSocket(const std::string& path) {
+    struct stat st{};
+    if (::stat(path.c_str(), &st) == 0 && st.st_ino == ownSocketInode()) ::unlink(path.c_str());
+}
+
+template <class Run>
+int serve(const std::string& tool, Run& run) {
+    std::string path = socketPath(tool);
+    int existing = connectTo(path);
+    if (existing >= 0) {
+        int code = exchange(existing, 'p', {});
+        ::close(existing);
+        // 同一个程序的服务已经在运行；旧程序的服务已删除套接字并退出，由本进程接管
+        if (code != kStaleServer) return 0;
+    }
+    sockaddr_un addr;
+    if (path.empty()) {
+        std::cerr << "无法使用本用户的套接字目录（需要是本用户所有、权限为 0700 的目录）\n";
+        return 1;
+    }
+    if (!makeAddress(path, addr)) {
+        std::cerr << "套接字路径过长：" << path << "\n";
+        return 1;
+    }
+    ::unlink(path.c_str());
+    int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listener, 4) != 0) {
+        std::cerr << "无法启动服务：" << std::strerror(errno) << "\n";
+        if (listener >= 0) ::close(listener);
+        return 1;
+    }
+    struct stat st{};
+    if (::stat(path.c_str(), &st) == 0) ownSocketInode() = st.st_ino;
+    ::signal(SIGPIPE, SIG_IGN);
+    // 只用来打断阻塞的读取，不设 SA_RESTART
+    struct sigaction interrupt{};
+    interrupt.sa_handler = [](int) {};
+    ::sigemptyset(&interrupt.sa_mask);
+    ::sigaction(kInterruptSignal, &interrupt, nullptr);
+    ::setsid();
+
+    const uint64_t identity = binaryIdentity();
+    while (true) {
+        pollfd p{listener, POLLIN, 0};
+        int ready = ::poll(&p, 1, kServeIdleSeconds * 1000);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) break;
+        int client = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) continue;
+        if (!peerIsSelf(client)) {
+            ::close(client);
+            continue;
+        }
+        char command = 0;
+        int fds[kMaxPassedFds];
+        uint64_t client_identity = 0;
+        std::vector<std::string> args;
+        bool ok = receiveCommand(client, command, fds, client_identity, args);
+        bool stale = ok && command != 's' && client_identity != identity;
+        // 停止时先删除套接字再回复，客户端收到回复后马上启动的新服务不会被删掉套接字
+        bool quit = ok && (command == 's' || stale);
+        int32_t code = 0;
+        if (stale) {
+            code = kStaleServer;
+        } else if (ok && command == 'r' && fds[kPassedFds - 1] >= 0) {
+            code = runWithStdio(client, fds, tool, args, run);
+        }
+        for (int fd : fds)
+            if (fd >= 0) ::close(fd);
+        if (quit) removeOwnSocket(path);
+        (void)writeAll(client, &code, sizeof(code));
+        ::close(client);
+        if (quit) break;
+    }
+    ::close(listener);
+    removeOwnSocket(path);
+    return 0;
+}
+
+// 交给服务运行，返回退出码；没有服务或服务属于旧程序时返回 -1
+inline int forward(const std::string& tool, char command, const std::vector<std::string>& args) {
+    int fd = connectTo(socketPath(tool));
+    if (fd < 0) return -1;
+    std::cout.flush();
+    std::cerr.flush();
+    if (!sendCommand(fd, command, args)) {
+        ::close(fd);
+        return -1;
+    }
+    int32_t code = 1;
+    if (!readAll(fd, &code, sizeof(code))) {
+        std::cerr << "服务意外中断\n";
+        code = 1;
+    }
+    ::close(fd);
+    if (code == kStaleServer) {
+        if (command == 'r') std::cerr << "服务来自旧版本的程序，已停止，本次直接运行\n";
+        return -1;
+    }
+    return code;
+}
+
+// 工具的 main：--serve 启动服务，--stop 停止服务，--local 不使用服务；
+// 其余情况有服务时交给服务运行，否则直接运行。run 的参数与 main 相同（不含以上选项）
+template <class Run>
+int runOrForward(int argc, char* argv[], const std::string& tool, Run run) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "--serve") return serve(tool, run);
+    if (mode == "--stop") {
+        forward(tool, 's', {});
+        return 0;
+    }
+    if (mode == "--local") {
+        argv[1] = argv[0];
+        return run(argc - 1, argv + 1);
+    }
+    int code = forward(tool, 'r', std::vector<std::string>(argv + 1, argv + argc));
+    if (code >= 0) return code;
+    return run(argc, argv);
+}
+
+}  // namespace toolserver
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <utility>
+#include <numeric>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "Cancel.h"
+
+inline size_t defaultThreadCount() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 4 : n;
+}
+
+// 固定线程数的工作窃取线程池。
+// 每批任务按权重（一般是文件字节数）从大到小，贪心分配到当前负载最小的线程队列；
+// 线程从自己队列头部取任务，队列空了就去其他线程队列尾部窃取，
+// 因此总耗时接近 总字节数 / 核数，而不是取决于最慢的那一份。
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t threads = 0) {
+        if (threads == 0) threads = defaultThreadCount();
+        for (size_t i = 0; i < threads; i++)
+            queues_.push_back(std::make_unique<Queue>());
+        for (size_t i = 0; i < threads; i++)
+            workers_.emplace_back([this, i]() { workerLoop(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    // 提交一批任务后立即返回。fn(worker, task)：worker 为线程下标（可用于线程私有的结果缓冲），
+    // task 为任务在 weights 中的下标。上一批任务必须已经 wait() 完毕。
+    void start(const std::vector<uint64_t>& weights, std::function<void(size_t, size_t)> fn) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            fn_ = std::move(fn);
+            error_ = nullptr;
+            cancelled_.store(false, std::memory_order_relaxed);
+            pending_ = weights.size();
+        }
+        std::vector<size_t> order(weights.size());
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::stable_sort(order.begin(), order.end(),
+                         [&](size_t a, size_t b) { return weights[a] > weights[b]; });
+        std::vector<uint64_t> load(queues_.size(), 0);
+        for (size_t task : order) {
+            size_t target = std::min_element(load.begin(), load.end()) - load.begin();
+            load[target] += std::max<uint64_t>(weights[task], 1);
+            Queue& q = *queues_[target];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(task);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            generation_++;
+        }
+        wake_.notify_all();
+    }
+
+    // 等待当前批次完成；任务中抛出的第一个异常会在这里重新抛出。
+    // 运行被取消（见 Cancel.h）时剩余任务没有执行，结果不完整，抛出 RunCancelled
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return pending_ == 0; });
+        fn_ = nullptr;
+        if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+        throwIfRunCancelled();
+    }
+
+    // 与 wait() 相同，等待期间每隔 interval 在调用线程中调用一次 tick（用于显示进度，不持有锁）
+    void wait(const std::function<void()>& tick, std::chrono::milliseconds interval) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!done_.wait_for(lock, interval, [this]() { return pending_ == 0; })) {
+            lock.unlock();
+            tick();
+            lock.lock();
+        }
+        lock.unlock();
+        wait();
+    }
+
+    void run(const std::vector<uint64_t>& weights, std::function<void(size_t, size_t)> fn) {
+        start(weights, std::move(fn));
+        wait();
+    }
+
+    // tick 为空时与 run(weights, fn) 相同
+    void run(const std::vector<uint64_t>& weights, std::function<void(size_t, size_t)> fn,
+             const std::function<void()>& tick, std::chrono::milliseconds interval) {
+        start(weights, std::move(fn));
+        if (tick)
+            wait(tick, interval);
+        else
+            wait();
+    }
+
+    // 取消当前批次：还没开始的任务直接丢弃，正在执行的任务照常完成。可以在任务内部调用
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+    bool cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    bool pop(size_t self, size_t& task) {
+        {
+            Queue& own = *queues_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues_.size(); k++) {
+            Queue& victim = *queues_[(self + k) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(size_t self) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+                if (stop_) return;
+                seen = generation_;
+            }
+            size_t task;
+            while (pop(self, task)) {
+                try {
+                    if (!cancelled() && !runCancelled()) fn_(self, task);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!error_) error_ = std::current_exception();
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (--pending_ == 0) done_.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::function<void(size_t, size_t)> fn_;
+    std::exception_ptr error_;
+    std::atomic<bool> cancelled_{false};
+    size_t pending_ = 0;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+};
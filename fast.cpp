@@ -1,45 +1,33 @@
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <string>
 #include <vector>
 #include <filesystem>
-#include <regex>
 #include <set>
-#include <unordered_map>
 #include <stdexcept>
-#include <optional>
 #include <algorithm>
 #include <cstdlib>
-#include <future>
 #include <mutex>
 #include <thread>
 #include <chrono>
+#include <unordered_map>
+
+#include "ByteSearch.h"
+#include "WorkStealing.h"
+#include "FilePatch.h"
+#include "Staging.h"
+#include "SwapPlan.h"
+#include "ConfigFile.h"
+#include "SkinLayout.h"
+#include "FileStamp.h"
+#include "ToolServer.h"
+#include "Progress.h"
 
 namespace fs = std::filesystem;
 
 std::set<std::string> modified_files;
 std::mutex g_modified_mutex;
 
-
-std::string trim(const std::string &s) {
-    size_t start = s.find_first_not_of(" \t\r\n");
-    if (start == std::string::npos) return "";
-    size_t end = s.find_last_not_of(" \t\r\n");
-    return s.substr(start, end - start + 1);
-}
-
-std::string bytesToHex(const std::vector<unsigned char>& data) {
-    std::ostringstream oss;
-    oss << std::hex;
-    for (unsigned char b : data) {
-        oss.width(2);
-        oss.fill('0');
-        oss << static_cast<int>(b);
-    }
-    return oss.str();
-}
-
 std::vector<unsigned char> hexStringToBytes(const std::string &hex) {
     std::vector<unsigned char> bytes;
     if(hex.size() % 2 != 0)
@@ -52,224 +40,232 @@ std::vector<unsigned char> hexStringToBytes(const std::string &hex) {
     return bytes;
 }
 
-std::vector<unsigned char> decimalTo4Byte(int value) {
-    std::vector<unsigned char> bytes(4);
-    for (int i = 0; i < 4; i++) {
-        bytes[i] = static_cast<unsigned char>((value >> (8 * i)) & 0xFF);
-    }
-    return bytes;
-}
-
-std::string intToHexLittleEndian(int n) {
-    auto bytes = decimalTo4Byte(n);
-    return bytesToHex(bytes);
-}
-
-
-size_t findSubvector(const std::vector<unsigned char>& data,
-                     const std::vector<unsigned char>& pattern,
-                     size_t start) {
-    if (pattern.empty() || data.size() < pattern.size())
-        return std::string::npos;
-    for (size_t i = start; i <= data.size() - pattern.size(); i++) {
-        bool found = true;
-        for (size_t j = 0; j < pattern.size(); j++) {
-            if (data[i+j] != pattern[j]) { found = false; break; }
-        }
-        if (found)
-            return i;
-    }
-    return std::string::npos;
-}
-
-
-
 struct Markers {
     std::vector<unsigned char> start_marker;
     std::vector<unsigned char> end_marker;
-    std::vector<unsigned char> target_marker;
 };
 
 
 Markers getMarkers(const std::string &start_marker_input,
-                   const std::string &end_marker_input,
-                   int target_marker_decimal) {
+                   const std::string &end_marker_input) {
     Markers m;
     m.start_marker = hexStringToBytes(start_marker_input);
     m.end_marker   = hexStringToBytes(end_marker_input);
-    m.target_marker = decimalTo4Byte(target_marker_decimal);
     return m;
 }
 
 
 
-struct FoundBlock {
-    std::string file;
-    std::string first_target_value;
-    size_t first_target_position;
-    std::string second_target_value;
-    size_t second_target_position;
+// 找到的块按列存放：代码直接存 uint32，文件存下标（路径只保存一份），位置存 32 位偏移。
+// 每个块只占 20 字节，不再为每个块复制路径和十六进制字符串。
+struct BlockTable {
+    std::vector<uint32_t> file;
+    std::vector<uint32_t> first_value;
+    std::vector<uint32_t> first_position;
+    std::vector<uint32_t> second_value;
+    std::vector<uint32_t> second_position;
+
+    size_t size() const { return file.size(); }
+
+    void push(uint32_t file_id, uint32_t value1, uint32_t pos1, uint32_t value2, uint32_t pos2) {
+        file.push_back(file_id);
+        first_value.push_back(value1);
+        first_position.push_back(pos1);
+        second_value.push_back(value2);
+        second_position.push_back(pos2);
+    }
+
+    // 追加另一张（单个文件的）块表，文件下标统一改为 file_id
+    void append(const BlockTable &other, uint32_t file_id) {
+        file.insert(file.end(), other.size(), file_id);
+        auto copy = [](std::vector<uint32_t> &to, const std::vector<uint32_t> &from) {
+            to.insert(to.end(), from.begin(), from.end());
+        };
+        copy(first_value, other.first_value);
+        copy(first_position, other.first_position);
+        copy(second_value, other.second_value);
+        copy(second_position, other.second_position);
+    }
 };
 
+// 代码 -> 块行号的开放寻址哈希表。同一代码出现多次时保留最后一行（与原先按文件顺序覆盖写入字典一致）
+class BlockIndex {
+public:
+    BlockIndex(const std::vector<uint32_t> &keys) {
+        size_t capacity = 16;
+        shift_ = 28;
+        while (capacity < keys.size() * 2) {
+            capacity <<= 1;
+            shift_--;
+        }
+        mask_ = capacity - 1;
+        keys_.assign(capacity, 0);
+        rows_.assign(capacity, kEmpty);
+        for (size_t row = 0; row < keys.size(); row++) {
+            size_t h = hash(keys[row]);
+            while (rows_[h] != kEmpty && keys_[h] != keys[row]) h = (h + 1) & mask_;
+            keys_[h] = keys[row];
+            rows_[h] = static_cast<uint32_t>(row);
+        }
+    }
 
-std::optional<std::vector<unsigned char>> little_endian_append_00(const std::vector<unsigned char>& byte_data) {
-    if (byte_data.size() < 4) return std::nullopt;
-    uint32_t decimal_value = byte_data[0] | (byte_data[1] << 8) | (byte_data[2] << 16) | (byte_data[3] << 24);
-    std::string dec_str = std::to_string(decimal_value) + "00";
-    try {
-        uint32_t new_decimal_value = std::stoul(dec_str);
-        if (new_decimal_value > 0xFFFFFFFF)
-            return std::nullopt;
-        std::vector<unsigned char> new_bytes(4);
-        new_bytes[0] = new_decimal_value & 0xFF;
-        new_bytes[1] = (new_decimal_value >> 8) & 0xFF;
-        new_bytes[2] = (new_decimal_value >> 16) & 0xFF;
-        new_bytes[3] = (new_decimal_value >> 24) & 0xFF;
-        return new_bytes;
-    } catch (...) {
-        return std::nullopt;
+    // 返回代码所在的行，不存在时返回 -1
+    int64_t find(uint32_t key) const {
+        size_t h = hash(key);
+        while (rows_[h] != kEmpty) {
+            if (keys_[h] == key) return rows_[h];
+            h = (h + 1) & mask_;
+        }
+        return -1;
     }
-}
 
+private:
+    static constexpr uint32_t kEmpty = 0xFFFFFFFF;
 
-std::optional<std::vector<unsigned char>> little_endian_remove_00(const std::vector<unsigned char>& byte_data) {
-    if (byte_data.size() < 4) return std::nullopt;
-    uint32_t decimal_value = byte_data[0] | (byte_data[1] << 8) | (byte_data[2] << 16) | (byte_data[3] << 24);
-    uint32_t new_decimal_value = decimal_value / 100;
-    if (new_decimal_value > 0xFFFFFFFF)
-        return std::nullopt;
-    std::vector<unsigned char> new_bytes(4);
-    new_bytes[0] = new_decimal_value & 0xFF;
-    new_bytes[1] = (new_decimal_value >> 8) & 0xFF;
-    new_bytes[2] = (new_decimal_value >> 16) & 0xFF;
-    new_bytes[3] = (new_decimal_value >> 24) & 0xFF;
-    return new_bytes;
-}
+    size_t hash(uint32_t v) const {
+        return static_cast<size_t>((v * 0x9E3779B1u) >> shift_);
+    }
+
+    std::vector<uint32_t> keys_;
+    std::vector<uint32_t> rows_;
+    size_t mask_ = 0;
+    unsigned shift_ = 28;
+};
 
 
+// 单次遍历同时查找两类块（见 SkinLayout.h），衣服块和载具块分别记入单个文件的两张块表。
+// 文件下标先记为 0，合并时由 BlockTable::append 填写
 void findBlocksInFile(const std::vector<unsigned char>& content,
-                      const std::string &file_path,
-                      std::vector<FoundBlock> &found_blocks,
+                      BlockTable &found_blocks,
+                      BlockTable &found_blocks_no_symmetric,
                       const std::vector<unsigned char> &start_marker,
-                      const std::vector<unsigned char> &end_marker,
-                      const std::vector<unsigned char> &target_marker) {
-    size_t idx_start = 0;
-    while (idx_start < content.size()) {
-        size_t start_idx = findSubvector(content, start_marker, idx_start);
-        if (start_idx == std::string::npos) break;
-        size_t end_idx = findSubvector(content, end_marker, start_idx + start_marker.size());
-        if (end_idx == std::string::npos) break;
-        if (end_idx - (start_idx + start_marker.size()) == 14) {
-            size_t target_start_idx = end_idx + end_marker.size() + 15;
-            if (target_start_idx + 4 > content.size()) break;
-            std::vector<unsigned char> first_target_value(content.begin() + target_start_idx,
-                                                           content.begin() + target_start_idx + 4);
-            size_t block_start = target_start_idx + 4;
-            size_t second_target_idx = findSubvector(content, first_target_value, block_start);
-            if (second_target_idx != std::string::npos) {
-                FoundBlock block;
-                block.file = file_path;
-                block.first_target_value = bytesToHex(first_target_value);
-                block.first_target_position = target_start_idx;
-                block.second_target_value = block.first_target_value;
-                block.second_target_position = second_target_idx;
-                found_blocks.push_back(block);
-            }
+                      const std::vector<unsigned char> &end_marker) {
+    forEachBlock(content.data(), content.size(), start_marker, end_marker, [&](const BlockMatch &match) {
+        if (match.cloth_position != bytesearch::npos) {
+            found_blocks.push(0, match.first_value, static_cast<uint32_t>(match.first_position),
+                              match.first_value, static_cast<uint32_t>(match.cloth_position));
         }
-        idx_start = end_idx + end_marker.size();
-    }
-}
-
-
-void findBlocksInFileVehicle(const std::vector<unsigned char>& content,
-                             const std::string &file_path,
-                             std::vector<FoundBlock> &found_blocks,
-                             const std::vector<unsigned char> &start_marker,
-                             const std::vector<unsigned char> &end_marker,
-                             const std::vector<unsigned char> &target_marker) {
-    size_t idx_start = 0;
-    while (idx_start < content.size()) {
-        size_t start_idx = findSubvector(content, start_marker, idx_start);
-        if (start_idx == std::string::npos) break;
-        size_t end_idx = findSubvector(content, end_marker, start_idx + start_marker.size());
-        if (end_idx == std::string::npos) break;
-        if (end_idx - (start_idx + start_marker.size()) == 14) {
-            size_t target_start_idx = end_idx + end_marker.size() + 15;
-            if (target_start_idx + 4 > content.size()) break;
-            std::vector<unsigned char> first_target_value(content.begin() + target_start_idx,
-                                                           content.begin() + target_start_idx + 4);
-            size_t block_start = target_start_idx + 4;
-            auto second_target_opt = little_endian_append_00(first_target_value);
-            if (!second_target_opt.has_value()) {
-                idx_start = end_idx + end_marker.size();
-                continue;
-            }
-            auto second_target_value = second_target_opt.value();
-            size_t second_target_idx = findSubvector(content, second_target_value, block_start);
-            if (second_target_idx != std::string::npos) {
-                FoundBlock block;
-                block.file = file_path;
-                block.first_target_value = bytesToHex(first_target_value);
-                block.first_target_position = target_start_idx;
-                block.second_target_value = bytesToHex(second_target_value);
-                block.second_target_position = second_target_idx;
-                found_blocks.push_back(block);
-            }
+        if (match.vehicle_position != bytesearch::npos) {
+            found_blocks_no_symmetric.push(0, match.first_value, static_cast<uint32_t>(match.first_position),
+                                           match.vehicle_value, static_cast<uint32_t>(match.vehicle_position));
         }
-        idx_start = end_idx + end_marker.size();
-    }
+    });
 }
 
 // ========== 文件处理 ==========
 
-void processFile(const std::string &file_path,
+// 读取失败时返回 false
+bool processFile(const std::string &file_path,
                  const std::vector<unsigned char> &start_marker,
                  const std::vector<unsigned char> &end_marker,
-                 const std::vector<unsigned char> &target_marker,
-                 std::vector<FoundBlock> &found_blocks,
-                 std::vector<FoundBlock> &found_blocks_no_symmetric) {
+                 BlockTable &found_blocks,
+                 BlockTable &found_blocks_no_symmetric) {
     try {
         std::ifstream ifs(file_path, std::ios::binary);
         if (!ifs) {
             std::cerr << "Error reading file " << file_path << "\n";
-            return;
+            return false;
         }
         std::vector<unsigned char> content((std::istreambuf_iterator<char>(ifs)),
                                              std::istreambuf_iterator<char>());
         ifs.close();
-        findBlocksInFile(content, file_path, found_blocks, start_marker, end_marker, target_marker);
-        findBlocksInFileVehicle(content, file_path, found_blocks_no_symmetric, start_marker, end_marker, target_marker);
+        // 块表中的位置为 32 位偏移
+        if (content.size() > 0xFFFFFFFFull) {
+            std::cerr << "跳过超过 4GB 的文件 " << file_path << "\n";
+            return false;
+        }
+        findBlocksInFile(content, found_blocks, found_blocks_no_symmetric, start_marker, end_marker);
+        return true;
     } catch (const std::exception &e) {
         std::cerr << "Error reading file " << file_path << ": " << e.what() << "\n";
+        return false;
     }
 }
 
-// 并行遍历指定文件夹中的所有文件，查找块
+// 每个文件的块表按文件的大小和修改时间缓存在进程内。单次运行时缓存为空；
+// 作为常驻服务（--serve）运行时，之后的每次运行只重新扫描发生变化的文件。
+struct FileBlocks {
+    FileStamp stamp;
+    BlockTable blocks;
+    BlockTable blocks_no_symmetric;
+};
+
+struct BlockCache {
+    std::vector<unsigned char> start_marker;
+    std::vector<unsigned char> end_marker;
+    std::unordered_map<std::string, FileBlocks> files;
+};
+
+BlockCache g_block_cache;
+
+// 并行遍历指定文件夹中的所有文件，查找块。
+// 使用固定大小的线程池，整批提交，大文件优先；每个文件写入自己的块表，最后按文件顺序合并。
+// files 返回扫描的文件列表，块表中的文件下标指向它。沿用缓存的文件直接计为已完成。
 void findHexBlocksInFolder(const std::string &folder_path,
                            const std::vector<unsigned char> &start_marker,
                            const std::vector<unsigned char> &end_marker,
-                           const std::vector<unsigned char> &target_marker,
-                           std::vector<FoundBlock> &found_blocks,
-                           std::vector<FoundBlock> &found_blocks_no_symmetric) {
-    std::vector<std::string> files;
+                           std::vector<std::string> &files,
+                           BlockTable &found_blocks,
+                           BlockTable &found_blocks_no_symmetric,
+                           ProgressReporter &progress) {
+    if (g_block_cache.start_marker != start_marker || g_block_cache.end_marker != end_marker) {
+        g_block_cache.files.clear();
+        g_block_cache.start_marker = start_marker;
+        g_block_cache.end_marker = end_marker;
+    }
+
+    files.clear();
+    std::vector<FileStamp> stamps;
     for (auto &entry : fs::recursive_directory_iterator(folder_path)) {
-        if (fs::is_regular_file(entry.path()))
+        if (fs::is_regular_file(entry.path())) {
+            FileStamp stamp;
+            stamp.mtime = -1;
             files.push_back(entry.path().string());
+            statFile(files.back(), stamp);
+            stamps.push_back(stamp);
+        }
     }
-    std::vector<std::future<void>> futures;
-    std::mutex mtx;
-    for (const auto &file : files) {
-        futures.push_back(std::async(std::launch::async, [&, file]() {
-            std::vector<FoundBlock> local_found;
-            std::vector<FoundBlock> local_found_no_sym;
-            processFile(file, start_marker, end_marker, target_marker, local_found, local_found_no_sym);
-            std::lock_guard<std::mutex> lock(mtx);
-            found_blocks.insert(found_blocks.end(), local_found.begin(), local_found.end());
-            found_blocks_no_symmetric.insert(found_blocks_no_symmetric.end(), local_found_no_sym.begin(), local_found_no_sym.end());
-        }));
-    }
-    for (auto &fut : futures) {
-        fut.get();
+
+    // 只扫描新增或发生变化的文件。扫描成功后才记下修改时间，读取失败或运行被取消（见 Cancel.h）
+    // 而没有扫描的文件修改时间保持 -1，下次重新扫描
+    std::vector<FileBlocks *> entries(files.size());
+    std::vector<size_t> changed;
+    std::vector<uint64_t> sizes;
+    std::unordered_map<std::string, FileBlocks> kept;
+    uint64_t total_bytes = 0, reused_bytes = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        total_bytes += stamps[i].size;
+        auto it = g_block_cache.files.find(files[i]);
+        FileBlocks &cached = kept[files[i]];
+        if (it != g_block_cache.files.end() && it->second.stamp.mtime >= 0 &&
+            it->second.stamp.size == stamps[i].size && it->second.stamp.mtime == stamps[i].mtime) {
+            cached = std::move(it->second);
+            reused_bytes += stamps[i].size;
+        } else {
+            cached.stamp = stamps[i];
+            cached.stamp.mtime = -1;
+            changed.push_back(i);
+            sizes.push_back(stamps[i].size);
+        }
+        entries[i] = &cached;
+    }
+    g_block_cache.files = std::move(kept);
+
+    progress.begin("扫描 uexp", files.size(), total_bytes);
+    progress.add(files.size() - changed.size(), reused_bytes);
+    WorkStealingPool pool;
+    pool.run(sizes, [&](size_t, size_t task) {
+        FileBlocks &entry = *entries[changed[task]];
+        if (processFile(files[changed[task]], start_marker, end_marker, entry.blocks,
+                        entry.blocks_no_symmetric))
+            entry.stamp.mtime = stamps[changed[task]].mtime;
+        progress.add(1, sizes[task]);
+    });
+    progress.end();
+
+    for (size_t i = 0; i < files.size(); i++) {
+        found_blocks.append(entries[i]->blocks, static_cast<uint32_t>(i));
+        found_blocks_no_symmetric.append(entries[i]->blocks_no_symmetric, static_cast<uint32_t>(i));
     }
 }
 
@@ -283,284 +279,74 @@ struct YAMLConfig {
 
 YAMLConfig readyaml(const std::string &file_path) {
     YAMLConfig config;
-    std::ifstream ifs(file_path);
-    if (!ifs) {
+    ConfigFile file;
+    if (!loadConfigFile(file_path, file)) {
         std::cerr << "无法打开 YAML 文件 " << file_path << "\n";
         return config;
     }
-    std::string line;
-    bool in_swap_pairs = false;
-    bool in_hex_markers = false;
-    std::regex pair_regex("-\\s*\\[\\s*(\\d+)\\s*,\\s*(\\d+)\\s*\\]");
-    std::regex key_value_regex("^\\s*(\\w+)\\s*:\\s*\"?(.*?)\"?$");
-    while (std::getline(ifs, line)) {
-        line = trim(line);
-        if (line.empty() || line[0] == '#') continue;
-        if (line.find("swap_pairs:") == 0) {
-            in_swap_pairs = true;
-            in_hex_markers = false;
-            continue;
-        }
-        if (line.find("hex_markers:") == 0) {
-            in_hex_markers = true;
-            in_swap_pairs = false;
-            continue;
-        }
-        if (in_swap_pairs && line[0] == '-') {
-            std::smatch m;
-            if (std::regex_search(line, m, pair_regex)) {
-                int a = std::stoi(m[1].str());
-                int b = std::stoi(m[2].str());
-                config.swap_pairs.push_back({a, b});
-            }
-        }
-        if (in_hex_markers) {
-            std::smatch m;
-            if (std::regex_search(line, m, key_value_regex)) {
-                std::string key = m[1].str();
-                std::string value = m[2].str();
-                if (key == "start")
-                    config.start_marker = value;
-                else if (key == "end")
-                    config.end_marker = value;
-            }
-        }
-    }
+    config.swap_pairs = file.pairsIn("swap_pairs");
+    if (const std::string *start = file.value("hex_markers", "start"))
+        config.start_marker = *start;
+    if (const std::string *end = file.value("hex_markers", "end"))
+        config.end_marker = *end;
     return config;
 }
 
 
-void swap_hex_values_in_file(const std::string &file1, size_t pos1, size_t pos2,
-                              const std::string &file2, size_t pos3, size_t pos4,
-                              const std::string &value1, const std::string &value2) {
-    if (!fs::exists(file1) || !fs::exists(file2)) {
-        std::cerr << "错误: 文件 " << file1 << " 或 " << file2 << " 不存在！\n";
-        return;
-    }
-    std::vector<unsigned char> content1, content2;
-    {
-        std::ifstream ifs(file1, std::ios::binary);
-        content1 = std::vector<unsigned char>((std::istreambuf_iterator<char>(ifs)),
-                                                std::istreambuf_iterator<char>());
-    }
-    {
-        std::ifstream ifs(file2, std::ios::binary);
-        content2 = std::vector<unsigned char>((std::istreambuf_iterator<char>(ifs)),
-                                                std::istreambuf_iterator<char>());
-    }
-    auto bytes_value1 = hexStringToBytes(value1);
-    auto bytes_value2 = hexStringToBytes(value2);
-    bool modified = false;
-    if (file1 == file2) {
-        if (std::equal(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos1) &&
-            std::equal(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos2)) {
-            std::copy(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos1);
-            std::copy(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos2);
-            modified = true;
-        }
-        if (std::equal(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos3) &&
-            std::equal(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos4)) {
-            std::copy(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos3);
-            std::copy(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos4);
-            modified = true;
-        }
-    } else {
-        if (std::equal(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos1) &&
-            std::equal(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos2)) {
-            std::copy(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos1);
-            std::copy(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos2);
-            modified = true;
-        }
-        if (std::equal(bytes_value2.begin(), bytes_value2.end(), content2.begin() + pos3) &&
-            std::equal(bytes_value2.begin(), bytes_value2.end(), content2.begin() + pos4)) {
-            std::copy(bytes_value1.begin(), bytes_value1.end(), content2.begin() + pos3);
-            std::copy(bytes_value1.begin(), bytes_value1.end(), content2.begin() + pos4);
-            modified = true;
-        }
-    }
-    if (modified) {
-        if (file1 == file2) {
-            std::ofstream ofs(file1, std::ios::binary);
-            ofs.write(reinterpret_cast<const char*>(content1.data()), content1.size());
-        } else {
-            std::ofstream ofs(file1, std::ios::binary);
-            ofs.write(reinterpret_cast<const char*>(content1.data()), content1.size());
-            std::ofstream ofs2(file2, std::ios::binary);
-            ofs2.write(reinterpret_cast<const char*>(content2.data()), content2.size());
-        }
-        {
-            std::lock_guard<std::mutex> lock(g_modified_mutex);
-            modified_files.insert(file1);
-            modified_files.insert(file2);
-        }
-    }
-}
+// 交换计划中的位置（块）以它原来的代码命名：衣服块用第一个目标值，载具块用 ×100 后的第二个目标值
+enum BlockKind : uint64_t { kClothBlock = 0, kVehicleBlock = 1 };
 
-// 交换文件中指定位置的 16 进制数据（载具用）
-void swap_hex_values_in_file_vehicle(const std::string &file1, size_t pos1, size_t pos2,
-                              const std::string &file2, size_t pos3, size_t pos4,
-                              const std::string &value1, const std::string &value2) {
-    if (!fs::exists(file1) || !fs::exists(file2)) {
-        std::cerr << "错误: 文件 " << file1 << " 或 " << file2 << " 不存在！\n";
-        return;
-    }
-    std::vector<unsigned char> content1, content2;
-    {
-        std::ifstream ifs(file1, std::ios::binary);
-        content1 = std::vector<unsigned char>((std::istreambuf_iterator<char>(ifs)),
-                                                std::istreambuf_iterator<char>());
-    }
-    {
-        std::ifstream ifs(file2, std::ios::binary);
-        content2 = std::vector<unsigned char>((std::istreambuf_iterator<char>(ifs)),
-                                                std::istreambuf_iterator<char>());
-    }
-    auto bytes_value1 = hexStringToBytes(value1);
-    auto bytes_value2 = hexStringToBytes(value2);
-    bool modified = false;
-    if (file1 == file2) {
-        if (std::equal(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos2)) {
-            std::copy(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos2);
-            modified = true;
-        }
-        if (std::equal(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos4)) {
-            std::copy(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos4);
-            modified = true;
-        }
-    } else {
-        if (std::equal(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos2)) {
-            std::copy(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos2);
-            modified = true;
-        }
-        if (std::equal(bytes_value2.begin(), bytes_value2.end(), content2.begin() + pos4)) {
-            std::copy(bytes_value1.begin(), bytes_value1.end(), content2.begin() + pos4);
-            modified = true;
-        }
-    }
-    if (modified) {
-        if (file1 == file2) {
-            std::ofstream ofs(file1, std::ios::binary);
-            ofs.write(reinterpret_cast<const char*>(content1.data()), content1.size());
-        } else {
-            std::ofstream ofs(file1, std::ios::binary);
-            ofs.write(reinterpret_cast<const char*>(content1.data()), content1.size());
-            std::ofstream ofs2(file2, std::ios::binary);
-            ofs2.write(reinterpret_cast<const char*>(content2.data()), content2.size());
-        }
-        {
-            std::lock_guard<std::mutex> lock(g_modified_mutex);
-            modified_files.insert(file1);
-            modified_files.insert(file2);
-        }
-    }
+uint64_t slotKey(BlockKind kind, uint32_t code) {
+    return (uint64_t(kind) << 32) | code;
 }
 
-// 交换文件中指定位置的 16 进制数据（武器用）
-void swap_hex_values_in_file_weapon(const std::string &file1, size_t pos1, size_t pos2,
-                              const std::string &file2, size_t pos3, size_t pos4,
-                              const std::string &value1, const std::string &value2) {
-    if (!fs::exists(file1) || !fs::exists(file2)) {
-        std::cerr << "错误: 文件 " << file1 << " 或 " << file2 << " 不存在！\n";
-        return;
-    }
-    std::vector<unsigned char> content1, content2;
-    {
-        std::ifstream ifs(file1, std::ios::binary);
-        content1 = std::vector<unsigned char>((std::istreambuf_iterator<char>(ifs)),
-                                                std::istreambuf_iterator<char>());
-    }
-    {
-        std::ifstream ifs(file2, std::ios::binary);
-        content2 = std::vector<unsigned char>((std::istreambuf_iterator<char>(ifs)),
-                                                std::istreambuf_iterator<char>());
-    }
-    auto bytes_value1 = hexStringToBytes(value1);
-    auto bytes_value2 = hexStringToBytes(value2);
-    bool modified = false;
-    if (file1 == file2) {
-        if (std::equal(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos2)) {
-            std::copy(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos2);
-            modified = true;
-        }
-        if ( std::equal(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos3) &&
-             std::equal(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos4) ) {
-            std::copy(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos3);
-            std::copy(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos4);
-            modified = true;
-        }
+// 把块改写为新值并记入补丁计划：衣服块改写对称的两个目标值，载具块只改写 ×100 的第二个目标值。
+// 写入前校验块中仍是原值（包含已计划的修改），不一致时不修改
+bool write_block_value(PatchPlan &plan, const std::vector<std::string> &files,
+                       const BlockTable &table, size_t row, BlockKind kind, uint32_t value) {
+    const std::string &file = files[table.file[row]];
+    if (!fs::exists(file)) {
+        std::cerr << "错误: 文件 " << file << " 不存在！\n";
+        return false;
+    }
+    unsigned char original[4], bytes[4];
+    storeLE32(value, bytes);
+    if (kind == kClothBlock) {
+        storeLE32(table.first_value[row], original);
+        if (!plan.matches(file, table.first_position[row], original, 4) ||
+            !plan.matches(file, table.second_position[row], original, 4))
+            return false;
+        plan.write(file, table.first_position[row], bytes, 4);
+        plan.write(file, table.second_position[row], bytes, 4);
     } else {
-        if (std::equal(bytes_value1.begin(), bytes_value1.end(), content1.begin() + pos2)) {
-            std::copy(bytes_value2.begin(), bytes_value2.end(), content1.begin() + pos2);
-            modified = true;
-        }
-        if ( std::equal(bytes_value2.begin(), bytes_value2.end(), content2.begin() + pos3) &&
-             std::equal(bytes_value2.begin(), bytes_value2.end(), content2.begin() + pos4) ) {
-            std::copy(bytes_value1.begin(), bytes_value1.end(), content2.begin() + pos3);
-            std::copy(bytes_value1.begin(), bytes_value1.end(), content2.begin() + pos4);
-            modified = true;
-        }
-    }
-    if (modified) {
-        if (file1 == file2) {
-            std::ofstream ofs(file1, std::ios::binary);
-            ofs.write(reinterpret_cast<const char*>(content1.data()), content1.size());
-        } else {
-            std::ofstream ofs(file1, std::ios::binary);
-            ofs.write(reinterpret_cast<const char*>(content1.data()), content1.size());
-            std::ofstream ofs2(file2, std::ios::binary);
-            ofs2.write(reinterpret_cast<const char*>(content2.data()), content2.size());
-        }
-        {
-            std::lock_guard<std::mutex> lock(g_modified_mutex);
-            modified_files.insert(file1);
-            modified_files.insert(file2);
-        }
-    }
-}
-
-
-void copy_uexp_files(const std::string &source_folder, const std::string &destination_folder) {
-    try {
-        if (fs::exists(destination_folder))
-            fs::remove_all(destination_folder);
-        fs::create_directories(destination_folder);
-        for (auto &entry : fs::directory_iterator(source_folder)) {
-            std::string src = entry.path().string();
-            std::string dest = (fs::path(destination_folder) / entry.path().filename()).string();
-            if (fs::is_regular_file(entry.path()))
-                fs::copy_file(entry.path(), dest, fs::copy_options::overwrite_existing);
-            else if (fs::is_directory(entry.path()))
-                fs::copy(entry.path(), dest, fs::copy_options::recursive);
-        }
-    } catch (const std::exception &e) {
-        std::cerr << "发生错误：" << e.what() << "\n";
-    }
+        storeLE32(table.second_value[row], original);
+        if (!plan.matches(file, table.second_position[row], original, 4))
+            return false;
+        plan.write(file, table.second_position[row], bytes, 4);
+    }
+    std::lock_guard<std::mutex> lock(g_modified_mutex);
+    modified_files.insert(file);
+    return true;
 }
 
-// 删除指定目录中不在 modified_files 集合内的文件
-void delete_unmodified_files(const std::string &directory, const std::set<std::string> &modified_files) {
-    for (auto &entry : fs::directory_iterator(directory)) {
-        std::string file_path = entry.path().string();
-        if (modified_files.find(file_path) == modified_files.end() && fs::is_regular_file(entry.path()))
-            fs::remove(entry.path());
-    }
-    std::cout << "美化完成，接下来请使用，uexp打包\n";
-}
-
-
 
 struct SwapPair {
     int first;
     int second;
 };
 
-int main() {
+int run_fast() {
 
-    copy_uexp_files("解包数据/uexp", "打包/uexp");
+    // 直接扫描解包数据，只有需要修改的文件才复制到打包目录
+    LazyStaging staging("解包数据/uexp", "打包/uexp");
+    try {
+        staging.reset();
+    } catch (const std::exception &e) {
+        std::cerr << "发生错误：" << e.what() << "\n";
+    }
 
     std::string start_marker_input = "";
     std::string end_marker_input = "";
-    int target_marker_decimal = 403211;
     std::string file_path = "cloth.yaml";
     std::string file_path_vehicle = "vehicle.yaml";
     std::string file_path_weapon = "weapon.yaml";
@@ -587,73 +373,65 @@ int main() {
     }
 
 
-    Markers markers = getMarkers(start_marker_input, end_marker_input, target_marker_decimal);
+    Markers markers = getMarkers(start_marker_input, end_marker_input);
 
-    std::vector<FoundBlock> found_blocks, found_blocks_no_symmetric;
-    findHexBlocksInFolder("打包/uexp", markers.start_marker, markers.end_marker, markers.target_marker,
-                            found_blocks, found_blocks_no_symmetric);
-
-    std::unordered_map<std::string, FoundBlock> found_blocks_dict;
-    for (const auto &block : found_blocks)
-        found_blocks_dict[block.first_target_value] = block;
-    std::unordered_map<std::string, FoundBlock> found_blocks_no_symmetric_dict;
-    for (const auto &block : found_blocks_no_symmetric)
-        found_blocks_no_symmetric_dict[block.second_target_value] = block;
-
-    std::vector<std::pair<FoundBlock, FoundBlock>> cloth_to_swap_temp;
-    for (const auto &pair : cloth_to_swap) {
-        std::string first_hex = intToHexLittleEndian(pair.first);
-        std::string last_hex = intToHexLittleEndian(pair.second);
-        if (found_blocks_dict.find(first_hex) != found_blocks_dict.end() &&
-            found_blocks_dict.find(last_hex) != found_blocks_dict.end()) {
-            cloth_to_swap_temp.push_back({found_blocks_dict[first_hex], found_blocks_dict[last_hex]});
-        }
-    }
-    for (const auto &p : cloth_to_swap_temp) {
-        swap_hex_values_in_file(p.first.file,
-                                 p.first.first_target_position, p.first.second_target_position,
-                                 p.second.file,
-                                 p.second.first_target_position, p.second.second_target_position,
-                                 p.first.first_target_value, p.second.first_target_value);
-    }
-
-    std::vector<std::pair<FoundBlock, FoundBlock>> vehicle_to_swap_temp;
-    for (const auto &pair : vehicle_to_swap) {
-        std::string first_hex = intToHexLittleEndian(pair.first);
-        std::string last_hex = intToHexLittleEndian(pair.second);
-        if (found_blocks_no_symmetric_dict.find(first_hex) != found_blocks_no_symmetric_dict.end() &&
-            found_blocks_no_symmetric_dict.find(last_hex) != found_blocks_no_symmetric_dict.end()) {
-            vehicle_to_swap_temp.push_back({found_blocks_no_symmetric_dict[first_hex],
-                                            found_blocks_no_symmetric_dict[last_hex]});
-        }
-    }
-    for (const auto &p : vehicle_to_swap_temp) {
-        swap_hex_values_in_file_vehicle(p.first.file,
-                                 p.first.first_target_position, p.first.second_target_position,
-                                 p.second.file,
-                                 p.second.first_target_position, p.second.second_target_position,
-                                 p.first.second_target_value, p.second.second_target_value);
-    }
-
-    std::vector<std::pair<FoundBlock, FoundBlock>> weapon_to_swap_temp;
-    for (const auto &pair : weapon_to_swap) {
-        std::string first_hex = intToHexLittleEndian(pair.first);
-        std::string last_hex = intToHexLittleEndian(pair.second);
-        if (found_blocks_no_symmetric_dict.find(first_hex) != found_blocks_no_symmetric_dict.end() &&
-            found_blocks_dict.find(last_hex) != found_blocks_dict.end()) {
-            weapon_to_swap_temp.push_back({found_blocks_no_symmetric_dict[first_hex],
-                                           found_blocks_dict[last_hex]});
+    ProgressReporter progress;
+    std::vector<std::string> files;
+    BlockTable found_blocks, found_blocks_no_symmetric;
+    findHexBlocksInFolder("解包数据/uexp", markers.start_marker, markers.end_marker, files,
+                          found_blocks, found_blocks_no_symmetric, progress);
+
+    // 衣服块按第一个目标值索引，载具块按 ×100 后的第二个目标值索引
+    BlockIndex found_blocks_dict(found_blocks.first_value);
+    BlockIndex found_blocks_no_symmetric_dict(found_blocks_no_symmetric.second_value);
+
+    // 衣服、载具、武器的交换对按顺序合成为一个置换，之后每个块只改写一次。武器交换的是载具块与衣服块。
+    // 交换对按值解释：(a, b) 交换当前持有 a 和 b 的块，因此链式交换 (a, b)、(b, c) 得到 a->c、b->a、c->b 的轮换。
+    // 这与原来按块位置逐对交换不同：原来后一对只在块仍是原值时才改写，同一个块被交换两次时结果会重复或丢失代码
+    SwapPermutation permutation;
+    auto add_pairs = [&](const std::vector<SwapPair> &pairs, BlockKind kind1, BlockKind kind2) {
+        for (const auto &pair : pairs) {
+            const BlockIndex &dict1 = kind1 == kClothBlock ? found_blocks_dict : found_blocks_no_symmetric_dict;
+            const BlockIndex &dict2 = kind2 == kClothBlock ? found_blocks_dict : found_blocks_no_symmetric_dict;
+            uint32_t code1 = static_cast<uint32_t>(pair.first), code2 = static_cast<uint32_t>(pair.second);
+            if (dict1.find(code1) < 0 || dict2.find(code2) < 0) continue;
+            permutation.swap(slotKey(kind1, code1), slotKey(kind2, code2));
         }
-    }
-    for (const auto &p : weapon_to_swap_temp) {
-        swap_hex_values_in_file_weapon(p.first.file,
-                                 p.first.first_target_position, p.first.second_target_position,
-                                 p.second.file,
-                                 p.second.first_target_position, p.second.second_target_position,
-                                 p.first.second_target_value, p.second.first_target_value);
-    }
-
-    delete_unmodified_files("打包/uexp", modified_files);
+    };
+    add_pairs(cloth_to_swap, kClothBlock, kClothBlock);
+    add_pairs(vehicle_to_swap, kVehicleBlock, kVehicleBlock);
+    add_pairs(weapon_to_swap, kVehicleBlock, kClothBlock);
+
+    auto conflicts = permutation.conflicts();
+    if (!conflicts.empty()) {
+        std::cout << "以下代码出现在多个交换对中，按配置顺序叠加交换：";
+        for (size_t i = 0; i < conflicts.size(); i++)
+            std::cout << (i ? ", " : "") << static_cast<uint32_t>(conflicts[i]);
+        std::cout << "\n";
+    }
+
+    PatchPlan plan;
+    for (const auto &[slot, value] : permutation.changes()) {
+        BlockKind kind = static_cast<BlockKind>(slot >> 32);
+        const BlockTable &table = kind == kClothBlock ? found_blocks : found_blocks_no_symmetric;
+        const BlockIndex &dict = kind == kClothBlock ? found_blocks_dict : found_blocks_no_symmetric_dict;
+        int64_t row = dict.find(static_cast<uint32_t>(slot));
+        write_block_value(plan, files, table, static_cast<size_t>(row), kind, static_cast<uint32_t>(value));
+    }
+
+    for (const auto &file : modified_files) {
+        if (staging.materialize(file).empty())
+            std::cerr << "错误: 无法复制文件 " << file << "\n";
+    }
+    auto failed = plan.commitInPlace([&](const std::string &file) { return staging.materialize(file); });
+    for (const auto &file : failed)
+        std::cerr << "错误: 无法写入文件 " << file << "\n";
+    std::cout << "美化完成，接下来请使用，uexp打包\n";
 
     return 0;
 }
+
+// 有常驻服务（./fast --serve）时交给服务运行，沿用服务中缓存的块表
+int main(int argc, char *argv[]) {
+    return toolserver::runOrForward(argc, argv, "fast", [](int, char *[]) { return run_fast(); });
+}